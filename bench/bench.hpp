@@ -0,0 +1,42 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+namespace hwmalloc2 {
+namespace bench {
+
+// best time per call of f in seconds, over `reps` repetitions of `iters` calls
+template<typename F>
+double measure(F&& f, std::size_t iters, std::size_t reps = 5) {
+    f(); // warm up
+    double best = 1e30;
+    for (std::size_t r = 0; r < reps; ++r) {
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < iters; ++i) f();
+        const std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+        best = std::min(best, d.count() / iters);
+    }
+    return best;
+}
+
+// bytes per second in GB/s
+inline double gbps(std::size_t bytes, double seconds) { return bytes / seconds * 1e-9; }
+
+// number of iterations such that roughly `total` bytes are moved
+inline std::size_t iterations(std::size_t bytes, std::size_t total = std::size_t{1} << 30) {
+    return std::max<std::size_t>(1u, total / std::max<std::size_t>(1u, bytes));
+}
+
+} // namespace bench
+} // namespace hwmalloc2
@@ -0,0 +1,118 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "bench.hpp"
+
+#include <hwmalloc2/resource_builder.hpp>
+#include <hwmalloc2/staging.hpp>
+
+#include <barrier>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// effect of cache line padding and coloring on multi-threaded packing
+// - every thread packs blocks of `fields` equally sized buffers (a page short of a power of two)
+//   into one staging buffer and unpacks them again, reading and writing all fields at the same
+//   offsets: without coloring, the fields map to the same cache sets
+// - every thread updates a small per-thread block (e.g. a message descriptor) after each block:
+//   without padding, the blocks of different threads share cache lines
+namespace {
+
+using namespace hwmalloc2;
+
+constexpr std::size_t fields = 16u;
+constexpr std::size_t field_size = (std::size_t{1} << 18) - 4096u;
+constexpr std::size_t block = 256u;
+
+struct descriptor {
+    std::size_t count;
+};
+
+// throughput of pack/unpack over all threads in GB/s
+double run(const arena_config& config, std::size_t num_threads) {
+    // fields and staging buffers are rounded up to powers of two (colors use that slack), one more
+    // thread worth of memory covers the descriptors and the alignment of the mapping
+    auto m = resource_builder().alloc_on_host((num_threads + 1) * 2 * fields * (std::size_t{1} << 18))
+        .add_arena(config).build();
+
+    // allocations are interleaved between threads, as they would be with a shared pool
+    std::vector<descriptor*> descriptors(num_threads);
+    for (auto& d : descriptors) d = static_cast<descriptor*>(m.allocate(sizeof(descriptor)));
+    std::vector<std::vector<unsigned char*>> data(num_threads);
+    std::vector<unsigned char*> staging(num_threads);
+    for (std::size_t t = 0; t < num_threads; ++t) {
+        for (std::size_t f = 0; f < fields; ++f) data[t].push_back(static_cast<unsigned char*>(m.allocate(field_size)));
+        staging[t] = static_cast<unsigned char*>(m.allocate(fields * field_size));
+        if (!staging[t] || !descriptors[t] || !data[t].back()) {
+            std::fprintf(stderr, "out of memory\n");
+            std::exit(1);
+        }
+    }
+
+    const copy_engine e;
+    constexpr std::size_t reps = 20u;
+    std::barrier sync{static_cast<std::ptrdiff_t>(num_threads + 1)};
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            auto d = descriptors[t];
+            auto& fs = data[t];
+            auto s = staging[t];
+            for (auto f : fs) std::memset(f, 1, field_size);
+            sync.arrive_and_wait();
+            for (std::size_t r = 0; r < reps; ++r) {
+                for (std::size_t i = 0; i < field_size; i += block) {
+                    for (std::size_t f = 0; f < fields; ++f) {
+                        e.copy(s + (i * fields) + f * block, fs[f] + i, block);
+                        reinterpret_cast<volatile std::size_t&>(d->count) = d->count + 1;
+                    }
+                }
+                for (std::size_t i = 0; i < field_size; i += block) {
+                    for (std::size_t f = 0; f < fields; ++f) {
+                        e.copy(fs[f] + i, s + (i * fields) + f * block, block);
+                        reinterpret_cast<volatile std::size_t&>(d->count) = d->count + 1;
+                    }
+                }
+            }
+            sync.arrive_and_wait();
+        });
+    }
+    sync.arrive_and_wait();
+    const auto start = std::chrono::steady_clock::now();
+    sync.arrive_and_wait();
+    const std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    for (auto& t : threads) t.join();
+
+    for (std::size_t t = 0; t < num_threads; ++t) {
+        for (auto f : data[t]) m.deallocate(f, field_size);
+        m.deallocate(staging[t], fields * field_size);
+        m.deallocate(descriptors[t], sizeof(descriptor));
+    }
+    return bench::gbps(2 * reps * fields * field_size * num_threads, d.count());
+}
+
+} // namespace
+
+int main() {
+    arena_config dense;
+    arena_config padded;
+    padded.cache_line_padding = true;
+    arena_config colored = padded;
+    colored.num_colors = 16u;
+
+    const auto max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::printf("# pack/unpack of %zu fields of %zu bytes per thread [GB/s]\n", fields, field_size);
+    std::printf("%8s %10s %10s %10s\n", "threads", "dense", "padded", "colored");
+    for (std::size_t t = 1; t <= max_threads; t *= 2)
+        std::printf("%8zu %10.2f %10.2f %10.2f\n", t, run(dense, t), run(padded, t), run(colored, t));
+}
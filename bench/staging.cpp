@@ -0,0 +1,73 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "bench.hpp"
+
+#include <hwmalloc2/resource_builder.hpp>
+#include <hwmalloc2/staging.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// compares the staging copy engine against memcpy for contiguous copies and against a memcpy per
+// block for strided packing, writing into buffers allocated from an arena
+int main() {
+    using namespace hwmalloc2;
+
+    constexpr std::size_t max_size = std::size_t{1} << 26;
+    auto m = resource_builder().alloc_on_host(2 * max_size).add_arena().build();
+    std::vector<unsigned char> src(2 * max_size, 1);
+
+    const copy_isa isas[] = {copy_isa::scalar, copy_isa::avx2, copy_isa::avx512};
+    const char* names[] = {"scalar", "avx2", "avx512"};
+
+    std::printf("# contiguous copy [GB/s]\n");
+    std::printf("%12s %10s", "bytes", "memcpy");
+    for (auto n : names) std::printf(" %10s %10s", n, "(nt)");
+    std::printf("\n");
+    for (std::size_t size = 4096; size <= max_size; size *= 4) {
+        auto b = m.allocate_at_least(size);
+        const auto iters = bench::iterations(size);
+        std::printf("%12zu %10.2f", size, bench::gbps(size, bench::measure([&] { std::memcpy(b.ptr, src.data(), size); }, iters)));
+        for (auto isa : isas) {
+            const copy_engine e{isa};
+            const copy_engine e_nt{isa, 0u};
+            std::printf(" %10.2f", bench::gbps(size, bench::measure([&] { e.copy(b.ptr, src.data(), size); }, iters)));
+            std::printf(" %10.2f", bench::gbps(size, bench::measure([&] { e_nt.copy(b.ptr, src.data(), size); }, iters)));
+        }
+        std::printf("\n");
+        m.deallocate(b.ptr, b.count);
+    }
+
+    std::printf("# strided pack [GB/s]\n");
+    std::printf("%12s %12s %10s", "block", "packed", "memcpy");
+    for (auto n : names) std::printf(" %10s %10s", n, "(nt)");
+    std::printf("\n");
+    for (std::size_t block : {8u, 64u, 1024u, 16384u}) {
+        for (std::size_t packed : {std::size_t{1} << 16, std::size_t{1} << 24}) {
+            const strided_layout l{packed / block, block, 2 * block};
+            auto b = m.allocate_at_least(packed);
+            const auto iters = bench::iterations(packed);
+            auto naive = [&] {
+                for (std::size_t i = 0; i < l.count; ++i)
+                    std::memcpy(static_cast<unsigned char*>(b.ptr) + i * block, src.data() + i * l.stride, block);
+            };
+            std::printf("%12zu %12zu %10.2f", block, packed, bench::gbps(packed, bench::measure(naive, iters)));
+            for (auto isa : isas) {
+                const copy_engine e{isa};
+                const copy_engine e_nt{isa, 0u};
+                std::printf(" %10.2f", bench::gbps(packed, bench::measure([&] { e.pack(b.ptr, src.data(), l); }, iters)));
+                std::printf(" %10.2f", bench::gbps(packed, bench::measure([&] { e_nt.pack(b.ptr, src.data(), l); }, iters)));
+            }
+            std::printf("\n");
+            m.deallocate(b.ptr, b.count);
+        }
+    }
+}
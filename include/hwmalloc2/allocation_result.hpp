@@ -0,0 +1,23 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace hwmalloc2 {
+
+// result of allocate_at_least, modelled after std::allocation_result (C++23):
+// `count` is the usable size of the block in bytes, at least the requested size
+struct allocation_result {
+    void*       ptr;
+    std::size_t count;
+};
+
+} // namespace hwmalloc2
@@ -9,6 +9,9 @@
  */
 #pragma once
 
+#include <hwmalloc2/allocation_result.hpp>
+#include <hwmalloc2/detail/clear.hpp>
+
 #include <cstddef>
 #include <any>
 #include <memory>
@@ -23,8 +26,12 @@ class any_resource {
   private:
     struct iface {
         virtual void* allocate(std::size_t, std::size_t) = 0;
+        virtual void* allocate_zeroed(std::size_t, std::size_t) = 0;
+        virtual allocation_result allocate_at_least(std::size_t, std::size_t) = 0;
+        virtual std::size_t usable_size(const void*) = 0;
         virtual void deallocate(void*, std::size_t, std::size_t) = 0;
         virtual std::any get_key(void*, std::size_t) = 0;
+        virtual bool try_resize_in_place(void*, std::size_t, std::size_t) = 0;
         virtual ~iface() = default;
     };
 
@@ -34,8 +41,31 @@ class any_resource {
         pimpl(R r) noexcept : _impl{std::move(r)} {}
         ~pimpl() override final = default;
         void* allocate(std::size_t s, std::size_t a) override final { return _impl.allocate(s, a); }
+        void* allocate_zeroed(std::size_t s, std::size_t a) override final {
+            if constexpr (requires { _impl.allocate_zeroed(s, a); }) return _impl.allocate_zeroed(s, a);
+            else {
+                void* p = _impl.allocate(s, a);
+                if (p) detail::clear(p, s);
+                return p;
+            }
+        }
+        allocation_result allocate_at_least(std::size_t s, std::size_t a) override final {
+            if constexpr (requires { _impl.allocate_at_least(s, a); }) return _impl.allocate_at_least(s, a);
+            else {
+                void* p = _impl.allocate(s, a);
+                return {p, p ? s : 0u};
+            }
+        }
+        std::size_t usable_size(const void* p) override final {
+            if constexpr (requires { _impl.usable_size(p); }) return _impl.usable_size(p);
+            else return 0u;
+        }
         void deallocate(void* p, std::size_t s, std::size_t a) override final { _impl.deallocate(p, s, a); }
         std::any get_key(void* p, std::size_t s) override final { return _impl.get_key(p, s); }
+        bool try_resize_in_place(void* p, std::size_t s, std::size_t n) override final {
+            if constexpr (requires { _impl.try_resize_in_place(p, s, n); }) return _impl.try_resize_in_place(p, s, n);
+            else return false;
+        }
     };
 
     std::unique_ptr<iface> _r;
@@ -46,9 +76,20 @@ class any_resource {
 
     void* allocate(std::size_t s, std::size_t a = alignof(std::max_align_t)) { return _r->allocate(s, a); }
 
+    void* allocate_zeroed(std::size_t s, std::size_t a = alignof(std::max_align_t)) { return _r->allocate_zeroed(s, a); }
+
+    allocation_result allocate_at_least(std::size_t s, std::size_t a = alignof(std::max_align_t)) {
+        return _r->allocate_at_least(s, a);
+    }
+
+    // usable size of an allocation, 0 if unknown
+    std::size_t usable_size(const void* p) { return _r->usable_size(p); }
+
     void deallocate(void* p, std::size_t s, std::size_t a = alignof(std::max_align_t)) { _r->deallocate(p, s, a); }
 
     std::any get_key(void* p, std::size_t s) { return _r->get_key(p, s); }
+
+    bool try_resize_in_place(void* p, std::size_t s, std::size_t n) { return _r->try_resize_in_place(p, s, n); }
 };
 
 } // namespace hwmalloc2
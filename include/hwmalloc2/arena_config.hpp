@@ -0,0 +1,75 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace hwmalloc2 {
+
+inline constexpr std::size_t cache_line_size = 64u;
+
+// exact-fit size classes in bytes, in addition to the power of two classes of an arena
+// the table can be written to and read from a stream (one size per line), such that classes
+// learned in one run can be used to start the next one
+struct size_class_table {
+    std::vector<std::size_t> sizes;
+
+    friend std::ostream& operator<<(std::ostream& os, const size_class_table& t) {
+        for (auto s : t.sizes) os << s << '\n';
+        return os;
+    }
+
+    // reads sizes until the end of the stream
+    friend std::istream& operator>>(std::istream& is, size_class_table& t) {
+        t.sizes.clear();
+        std::size_t s;
+        while (is >> s) t.sizes.push_back(s);
+        if (is.eof()) is.clear(std::ios_base::eofbit);
+        return is;
+    }
+};
+
+// allocations with different tags are served from separate slabs of the same arena, such that
+// allocations with different lifetimes (e.g. persistent buffers and temporaries) do not share slabs;
+// the meaning of the tags is up to the user; tags range from 0 to num_arena_tags - 1, allocations
+// with other tags fail (return nullptr)
+using arena_tag = std::uint8_t;
+
+inline constexpr std::size_t num_arena_tags = 4u;
+
+inline constexpr arena_tag default_tag = 0u;
+
+// tuning parameters of arenas
+struct arena_config {
+    // learn exact-fit size classes for frequently requested sizes at runtime
+    bool adaptive = false;
+    // record the size of every sample_period-th request
+    std::size_t sample_period = 16u;
+    // rebuild the exact-fit classes after this many samples
+    std::size_t rebuild_period = 4096u;
+    // share of the samples a size needs to get its own class
+    double hot_fraction = 0.05;
+    // initial exact-fit classes, e.g. exported from an earlier run
+    size_class_table size_classes;
+    // round small blocks up to whole cache lines, such that blocks used by different threads do
+    // not share a line
+    bool cache_line_padding = false;
+    // rotate the start of large blocks and of exact-fit slabs over this many cache lines (at most
+    // a page worth), such that buffers of the same size do not map to the same cache sets; colors
+    // only use the slack left by rounding up to the block or slab size and take no extra memory,
+    // blocks without slack (exact powers of two) are not colored
+    std::size_t num_colors = 1u;
+};
+
+} // namespace hwmalloc2
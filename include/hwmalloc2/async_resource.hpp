@@ -0,0 +1,198 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+namespace hwmalloc2 {
+
+// resource which lets callers wait for memory instead of failing when it is exhausted
+// - allocate_async either returns an awaitable (co_await yields the pointer) or takes a callback
+//   which is invoked with the pointer
+// - requests which cannot be served right away are queued in FIFO order and served from the
+//   deallocate path as soon as the request at the head of the queue fits: coroutines are resumed
+//   and callbacks are invoked on the deallocating thread, after the internal lock was released
+// - allocate does not wait and may overtake queued requests
+// - requests which the nested resource cannot serve even with all its memory free (see max_size
+//   of the arenas) are not queued, they receive a nullptr right away
+// - waiters still queued when the resource is destroyed receive a nullptr
+// calls to the nested resource are serialized by a mutex; the resource is neither copyable nor
+// movable
+template<typename Resource>
+class async_resource {
+  public:
+    // queued request (intrusive list node)
+    struct waiter {
+        std::size_t size;
+        std::size_t alignment;
+        void*       ptr = nullptr;
+        waiter*     next = nullptr;
+        void (*complete)(waiter*) = nullptr;
+    };
+
+    class awaiter : waiter {
+        friend class async_resource;
+
+        async_resource*         _res;
+        std::coroutine_handle<> _handle;
+
+        awaiter(async_resource* r, std::size_t s, std::size_t alignment) noexcept : waiter{s, alignment}, _res{r} {}
+
+      public:
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            _handle = h;
+            this->complete = [](waiter* w) { static_cast<awaiter*>(w)->_handle.resume(); };
+            return !_res->allocate_or_enqueue(*this);
+        }
+
+        void* await_resume() const noexcept { return this->ptr; }
+    };
+
+  private:
+    Resource    _r;
+    std::mutex  _mutex;
+    waiter*     _head = nullptr;
+    waiter*     _tail = nullptr;
+    std::size_t _num_waiters = 0u;
+
+  public:
+    async_resource(Resource&& r) : _r{std::move(r)} {}
+
+    async_resource(const async_resource&) = delete;
+    async_resource& operator=(const async_resource&) = delete;
+
+    ~async_resource() {
+        waiter* w = std::exchange(_head, nullptr);
+        complete_all(w);
+    }
+
+    void* allocate(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        std::lock_guard<std::mutex> lock{_mutex};
+        return _r.allocate(s, alignment);
+    }
+
+    // co_await allocate_async(s) yields a pointer to at least s bytes
+    awaiter allocate_async(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) noexcept {
+        return {this, s, alignment};
+    }
+
+    // invoke f with a pointer to at least s bytes, right away if possible
+    template<typename F>
+        requires std::invocable<F&, void*>
+    void allocate_async(std::size_t s, std::size_t alignment, F&& f) {
+        struct node : waiter {
+            std::decay_t<F> f;
+
+            static void invoke(waiter* w) {
+                std::unique_ptr<node> n{static_cast<node*>(w)};
+                n->f(n->ptr);
+            }
+        };
+        auto n = std::make_unique<node>(node{{s, alignment, nullptr, nullptr, &node::invoke}, std::forward<F>(f)});
+        if (allocate_or_enqueue(*n)) node::invoke(n.release());
+        else n.release();
+    }
+
+    template<typename F>
+        requires std::invocable<F&, void*>
+    void allocate_async(std::size_t s, F&& f) {
+        allocate_async(s, alignof(std::max_align_t), std::forward<F>(f));
+    }
+
+    // return memory and serve queued requests
+    void deallocate(void* ptr, std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        waiter* done;
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            _r.deallocate(ptr, s, alignment);
+            done = serve();
+        }
+        complete_all(done);
+    }
+
+    // serve queued requests, e.g. after memory was made available by other means
+    void poll() {
+        waiter* done;
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            done = serve();
+        }
+        complete_all(done);
+    }
+
+    std::size_t num_waiters() {
+        std::lock_guard<std::mutex> lock{_mutex};
+        return _num_waiters;
+    }
+
+    std::size_t usable_size(const void* ptr) {
+        std::lock_guard<std::mutex> lock{_mutex};
+        if constexpr (requires { _r.usable_size(ptr); }) return _r.usable_size(ptr);
+        else return 0u;
+    }
+
+    auto get_key(void* ptr, std::size_t s) { return _r.get_key(ptr, s); }
+
+  private:
+    // allocate right away if nobody is waiting, otherwise join the queue
+    bool allocate_or_enqueue(waiter& w) {
+        std::lock_guard<std::mutex> lock{_mutex};
+        if (!can_serve(w)) return true;
+        if (!_head && (w.ptr = _r.allocate(w.size, w.alignment))) return true;
+        w.next = nullptr;
+        if (_tail) _tail->next = &w;
+        else _head = &w;
+        _tail = &w;
+        ++_num_waiters;
+        return false;
+    }
+
+    // whether the request fits the nested resource at all, otherwise it would block the queue forever
+    bool can_serve(const waiter& w) const noexcept {
+        if constexpr (requires { _r.max_size(); }) return std::max(w.size, w.alignment) <= _r.max_size();
+        else return true;
+    }
+
+    // dequeue the requests which can be served now, in order (requires the lock)
+    waiter* serve() {
+        waiter* first = _head;
+        waiter* last = nullptr;
+        while (_head) {
+            if (!(_head->ptr = _r.allocate(_head->size, _head->alignment))) break;
+            last = _head;
+            _head = _head->next;
+            --_num_waiters;
+        }
+        if (!last) return nullptr;
+        last->next = nullptr;
+        if (!_head) _tail = nullptr;
+        return first;
+    }
+
+    static void complete_all(waiter* w) {
+        while (w) {
+            // the node may not outlive its completion
+            waiter* next = w->next;
+            w->complete(w);
+            w = next;
+        }
+    }
+};
+
+} // namespace hwmalloc2
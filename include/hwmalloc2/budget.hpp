@@ -0,0 +1,322 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc2/allocation_result.hpp>
+#include <hwmalloc2/detail/clear.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include <sys/resource.h>
+
+namespace hwmalloc2 {
+
+// what to do when a charge would exceed the limit of a budget
+enum class budget_policy {
+    fail,  // the allocation fails (returns nullptr)
+    trim,  // call budget_config::reclaim once and retry
+    wait   // block until enough bytes are released or the timeout expires
+};
+
+struct budget_config {
+    std::size_t   limit = std::numeric_limits<std::size_t>::max();
+    budget_policy policy = budget_policy::fail;
+    // on_high_watermark is called (on the charging thread) when the usage rises to or above
+    // high_watermark; it is called again only after the usage has dropped below
+    std::size_t                      high_watermark = std::numeric_limits<std::size_t>::max();
+    std::function<void(std::size_t)> on_high_watermark;
+    // release cached memory, e.g. pooled buffers (trim policy)
+    std::function<void()> reclaim;
+    // how long to wait for released bytes (wait policy)
+    std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max();
+};
+
+// snapshot of the counters of a budget
+struct budget_counters {
+    std::size_t used = 0u;
+    std::size_t peak = 0u;
+    std::size_t failed_charges = 0u;
+};
+
+namespace detail {
+
+// locked memory limit of the process
+inline std::size_t memlock_limit() noexcept {
+    ::rlimit l;
+    if (::getrlimit(RLIMIT_MEMLOCK, &l) != 0 || l.rlim_cur == RLIM_INFINITY)
+        return std::numeric_limits<std::size_t>::max();
+    return static_cast<std::size_t>(l.rlim_cur);
+}
+
+} // namespace detail
+
+// cap on the number of bytes held by one or more resources: bytes handed out (see
+// budgeted_resource) or memory locked by pinning and registration (see detail::locked_bytes)
+// charges and releases are lock free, the mutex is only taken by waiting charges (and by releases
+// while there are waiters); a budget can be shared by resources and threads and must outlive them
+class budget {
+    budget_config            _config;
+    std::atomic<std::size_t> _used{0u};
+    std::atomic<std::size_t> _peak{0u};
+    std::atomic<std::size_t> _failed{0u};
+    std::atomic<std::size_t> _waiters{0u};
+    std::atomic<bool>        _above{false};
+    std::mutex               _mutex;
+    std::condition_variable  _cv;
+
+  public:
+    budget(const budget_config& config = {}) : _config{config} {}
+
+    budget(const budget&) = delete;
+    budget& operator=(const budget&) = delete;
+
+    // process wide budget for locked memory, limited by RLIMIT_MEMLOCK: pass it to the pinned or
+    // registered layer (resource_builder::pin, resource_builder::register_memory)
+    static budget& process() {
+        static budget b{[] {
+            budget_config c;
+            c.limit = detail::memlock_limit();
+            return c;
+        }()};
+        return b;
+    }
+
+    const budget_config& config() const noexcept { return _config; }
+
+    std::size_t limit() const noexcept { return _config.limit; }
+
+    std::size_t used() const noexcept { return _used.load(std::memory_order_relaxed); }
+
+    budget_counters counters() const noexcept {
+        return {_used.load(std::memory_order_relaxed), _peak.load(std::memory_order_relaxed),
+            _failed.load(std::memory_order_relaxed)};
+    }
+
+    // charge n bytes if this does not exceed the limit
+    bool try_charge(std::size_t n) {
+        auto used = _used.load(std::memory_order_relaxed);
+        do {
+            if (n > _config.limit - std::min(used, _config.limit)) return false;
+        } while (!_used.compare_exchange_weak(used, used + n, std::memory_order_relaxed));
+        charged(used + n);
+        return true;
+    }
+
+    // charge n bytes, applying the policy if the limit is reached
+    bool charge(std::size_t n) {
+        if (try_charge(n)) return true;
+        if (_config.policy == budget_policy::trim && _config.reclaim) {
+            _config.reclaim();
+            if (try_charge(n)) return true;
+        }
+        else if (_config.policy == budget_policy::wait && n <= _config.limit) {
+            if (wait(n)) return true;
+        }
+        _failed.fetch_add(1u, std::memory_order_relaxed);
+        return false;
+    }
+
+    void release(std::size_t n) {
+        if (!n) return;
+        const auto used = _used.fetch_sub(n, std::memory_order_seq_cst) - n;
+        if (used < _config.high_watermark) _above.store(false, std::memory_order_relaxed);
+        if (_waiters.load(std::memory_order_seq_cst)) {
+            // synchronize with waiters which are about to block
+            { std::lock_guard<std::mutex> lock{_mutex}; }
+            _cv.notify_all();
+        }
+    }
+
+  private:
+    void charged(std::size_t used) {
+        auto peak = _peak.load(std::memory_order_relaxed);
+        while (peak < used && !_peak.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {}
+        if (used >= _config.high_watermark && !_above.exchange(true, std::memory_order_relaxed) &&
+            _config.on_high_watermark)
+            _config.on_high_watermark(used);
+    }
+
+    bool wait(std::size_t n) {
+        std::unique_lock<std::mutex> lock{_mutex};
+        _waiters.fetch_add(1u, std::memory_order_seq_cst);
+        const auto pred = [&] { return try_charge(n); };
+        bool ok = true;
+        if (_config.timeout == std::chrono::nanoseconds::max()) _cv.wait(lock, pred);
+        else ok = _cv.wait_for(lock, _config.timeout, pred);
+        _waiters.fetch_sub(1u, std::memory_order_relaxed);
+        return ok;
+    }
+};
+
+namespace detail {
+
+// charge for the memory locked by a pinned or registered layer: the whole memory up front, or on
+// reserved memory the chunks as they are committed (see reserved_memory::charge_commits)
+// throws std::bad_alloc if the budget is exhausted; the charge is released on destruction
+class locked_bytes {
+    budget*     _budget = nullptr;
+    std::size_t _bytes = 0u;
+
+  public:
+    locked_bytes() noexcept = default;
+
+    template<typename Resource>
+    locked_bytes(budget* b, Resource& r) {
+        if (!b) return;
+        if constexpr (requires { r.charge_commits(*b); }) r.charge_commits(*b);
+        else {
+            if (!b->charge(r.size())) throw std::bad_alloc{};
+            _budget = b;
+            _bytes = r.size();
+        }
+    }
+
+    locked_bytes(locked_bytes&& other) noexcept
+    : _budget{std::exchange(other._budget, nullptr)}
+    , _bytes{other._bytes}
+    {}
+
+    locked_bytes& operator=(locked_bytes&&) = delete;
+
+    ~locked_bytes() {
+        if (_budget) _budget->release(_bytes);
+    }
+};
+
+} // namespace detail
+
+// resource which charges its allocations to a budget
+// allocations are charged with their usable size if the resource reports it (e.g. arenas), and
+// with the requested size otherwise; the usage never exceeds the limit: when it is reached,
+// allocations fail (return nullptr) according to the policy of the budget
+template<typename Resource>
+class budgeted_resource {
+    Resource _r;
+    budget*  _budget;
+
+  public:
+    budgeted_resource(Resource&& r, budget& b) : _r{std::move(r)}, _budget{&b} {}
+
+    budgeted_resource(budgeted_resource&&) noexcept = default;
+
+    budget& get_budget() const noexcept { return *_budget; }
+
+    Resource& resource() noexcept { return _r; }
+
+    void* allocate(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        return allocate_at_least(s, alignment).ptr;
+    }
+
+    void* allocate_zeroed(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        return charge_and_allocate(s, alignment, [&]() -> void* {
+            if constexpr (requires { _r.allocate_zeroed(s, alignment); }) return _r.allocate_zeroed(s, alignment);
+            else {
+                void* ptr = _r.allocate(s, alignment);
+                if (ptr) detail::clear(ptr, s);
+                return ptr;
+            }
+        });
+    }
+
+    allocation_result allocate_at_least(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        allocation_result r{nullptr, 0u};
+        void* ptr = charge_and_allocate(s, alignment, [&]() -> void* {
+            if constexpr (requires { _r.allocate_at_least(s, alignment); }) r = _r.allocate_at_least(s, alignment);
+            else {
+                r.ptr = _r.allocate(s, alignment);
+                r.count = r.ptr ? s : 0u;
+            }
+            return r.ptr;
+        });
+        // the last block may have been given back
+        if (!ptr) return {nullptr, 0u};
+        return r;
+    }
+
+    std::size_t usable_size(const void* ptr) const noexcept {
+        if constexpr (requires { _r.usable_size(ptr); }) return _r.usable_size(ptr);
+        else return 0u;
+    }
+
+    void deallocate(void* ptr, std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        const auto n = charged_size(ptr, s);
+        _r.deallocate(ptr, s, alignment);
+        _budget->release(n);
+    }
+
+    // growing never waits for the budget
+    bool try_resize_in_place(void* ptr, std::size_t old_size, std::size_t new_size) {
+        if constexpr (requires { _r.try_resize_in_place(ptr, old_size, new_size); }) {
+            const auto old_n = charged_size(ptr, old_size);
+            if (new_size > old_n && !_budget->try_charge(new_size - old_n)) return false;
+            if (!_r.try_resize_in_place(ptr, old_size, new_size)) {
+                if (new_size > old_n) _budget->release(new_size - old_n);
+                return false;
+            }
+            // settle the difference to the actual size of the block, which must fit the limit too
+            const auto new_n = charged_size(ptr, new_size);
+            const auto charged = std::max(new_size, old_n);
+            if (new_n > charged && !_budget->try_charge(new_n - charged)) {
+                _r.try_resize_in_place(ptr, new_size, old_size);
+                _budget->release(charged - old_n);
+                return false;
+            }
+            if (new_n < charged) _budget->release(charged - new_n);
+            return true;
+        }
+        else return false;
+    }
+
+    auto get_key(void* ptr, std::size_t s) { return _r.get_key(ptr, s); }
+
+  private:
+    // the budget is charged before memory is handed out: first with the requested size, and if the
+    // block turns out to be larger (rounding), with the difference on top; if that does not fit,
+    // the block is returned and the allocation is retried with its full size charged up front, such
+    // that the usage never exceeds the limit
+    template<typename Allocate>
+    void* charge_and_allocate(std::size_t s, std::size_t alignment, Allocate&& allocate) {
+        auto charged = s;
+        if (!_budget->charge(charged)) return nullptr;
+        for (;;) {
+            void* ptr = allocate();
+            if (!ptr) {
+                _budget->release(charged);
+                return nullptr;
+            }
+            const auto n = charged_size(ptr, s);
+            if (n <= charged) {
+                _budget->release(charged - n);
+                return ptr;
+            }
+            if (_budget->try_charge(n - charged)) return ptr;
+            _r.deallocate(ptr, s, alignment);
+            _budget->release(charged);
+            charged = n;
+            if (!_budget->charge(charged)) return nullptr;
+        }
+    }
+
+    std::size_t charged_size(const void* ptr, std::size_t s) const noexcept {
+        const auto n = usable_size(ptr);
+        return n ? n : s;
+    }
+};
+
+} // namespace hwmalloc2
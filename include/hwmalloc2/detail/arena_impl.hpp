@@ -0,0 +1,658 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc2/arena_config.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hwmalloc2 {
+namespace detail {
+
+// granularity of the page heap: large blocks and slabs are made of pages
+inline constexpr std::size_t page_size = 4096u;
+
+// smallest block handed out by the arena
+inline constexpr std::size_t min_block_size = alignof(std::max_align_t);
+
+// largest request which is served from a slab, larger requests get whole pages
+inline constexpr std::size_t max_small_size = page_size / 2;
+
+// arena algorithm operating on a contiguous range of memory
+// - large requests are served by a binary buddy allocator at page granularity: a block of order k
+//   spans 2^k pages and its absolute address is aligned to its size
+// - small requests are rounded up to a power of two size class and carved from slabs, which are
+//   buddy blocks themselves: blocks of a class are therefore aligned to the class size
+// since all blocks are naturally aligned, an alignment request is met by picking a large enough
+// class and frees need neither a header nor a back pointer
+// bookkeeping is kept out of band, only released small blocks store a free list link in-band
+//
+// the arena tracks which memory is pristine, i.e. known to read as zero because it was never
+// handed out since it was mapped or decommitted: heads of free blocks carry a flag (split blocks
+// inherit it, merged blocks combine it) and slabs remember whether their pages were pristine, in
+// which case blocks beyond the bump index still are
+//
+// small requests carry a tag (see arena_tag), each tag has its own slabs: when all blocks of a
+// tag are released, its slabs become empty and return to the page heap as a whole; requests with
+// a tag of num_arena_tags or above fail
+//
+// optionally, small blocks are padded to whole cache lines, and large blocks and exact-fit slabs
+// are colored: their first byte is offset by a rotating number of cache lines, which spreads
+// equally sized buffers over the cache sets; colors only use the slack left by rounding up to the
+// block or slab size, and large blocks stay within their first page, such that frees still find
+// the block by its page
+//
+// optionally, request sizes are sampled and exact-fit classes are built for the most frequent
+// sizes (up to max_exact_size), which are served from slabs with blocks of exactly that size
+// (rounded to min_block_size); they are used for requests without extended alignment only
+class arena_impl {
+  public:
+    static constexpr std::uint32_t npos = ~std::uint32_t{0};
+    static constexpr std::size_t   max_order = 32u;
+    static constexpr std::size_t   num_classes =
+        std::countr_zero(max_small_size) - std::countr_zero(min_block_size) + 1;
+    static constexpr std::size_t   max_exact_classes = 8u;
+    static constexpr std::size_t   max_exact_size = 16u * page_size;
+
+  private:
+    enum class page_state : std::uint8_t { none, free, used, slab };
+
+    struct page {
+        std::uint32_t prev = npos;  // free list links (heads of free blocks)
+        std::uint32_t next = npos;
+        std::uint32_t slab = npos;  // owning slab (slab pages)
+        std::uint8_t  order = 0;    // block order (block heads)
+        page_state    state = page_state::none;
+        bool          pristine = false; // (heads of free blocks)
+    };
+
+    struct slab {
+        unsigned char* base = nullptr;
+        void*          free = nullptr;  // released blocks (intrusive list)
+        std::uint32_t  block_size = 0;
+        std::uint32_t  capacity = 0;
+        std::uint32_t  used = 0;
+        std::uint32_t  bump = 0;        // blocks beyond this index were never handed out
+        std::uint32_t  prev = npos;     // links in the partial list of its class
+        std::uint32_t  next = npos;
+        std::uint32_t  first_page = npos;
+        std::uint8_t   order = 0;
+        std::uint8_t   cls = 0;
+        std::uint8_t   tag = 0;
+        bool           retired = false; // its exact-fit class was replaced
+        bool           pristine = false; // its pages were pristine when it was created
+    };
+
+    static constexpr std::size_t num_lookup = max_small_size / min_block_size + 1;
+
+    unsigned char*                          _base = nullptr;
+    std::size_t                             _base_pfn = 0u;
+    std::size_t                             _num_pages = 0u;
+    std::vector<page>                       _pages;
+    std::array<std::uint32_t, max_order+1>  _free_blocks;
+    std::vector<slab>                       _slabs;
+    std::uint32_t                           _free_slabs = npos;
+    std::array<std::array<std::uint32_t, num_classes + max_exact_classes>, num_arena_tags> _partial;
+
+    // exact-fit classes (0 marks an unused class) and class look-up for small sizes
+    std::array<std::size_t, max_exact_classes>  _exact;
+    std::size_t                                 _num_exact = 0u;
+    std::array<std::uint8_t, num_lookup>        _class_of;
+
+    // size sampling
+    arena_config                                 _config;
+    std::unordered_map<std::size_t, std::size_t> _histogram;
+    std::size_t                                  _tick = 0u;
+    std::size_t                                  _num_samples = 0u;
+
+    // next color (cache line offset)
+    std::size_t                                  _color = 0u;
+
+  public:
+    arena_impl() noexcept {
+        _free_blocks.fill(npos);
+        for (auto& p : _partial) p.fill(npos);
+        _exact.fill(0u);
+        update_lookup();
+    }
+
+    // `zeroed` tells whether the memory reads as zero initially
+    arena_impl(void* ptr, std::size_t size, const arena_config& config = {}, bool zeroed = false) : arena_impl() {
+        _config = config;
+        _config.sample_period = std::max<std::size_t>(1u, _config.sample_period);
+        _config.rebuild_period = std::max<std::size_t>(1u, _config.rebuild_period);
+        _config.num_colors = std::clamp<std::size_t>(_config.num_colors, 1u, page_size / cache_line_size);
+        set_size_classes(_config.size_classes);
+        if (!ptr) return;
+        const auto addr = reinterpret_cast<std::uintptr_t>(ptr);
+        _base_pfn = (addr + page_size - 1) / page_size;
+        _base = static_cast<unsigned char*>(ptr) + (_base_pfn * page_size - addr);
+        extend(static_cast<unsigned char*>(ptr) + size, zeroed);
+    }
+
+    arena_impl(arena_impl&&) noexcept = default;
+    arena_impl& operator=(arena_impl&&) noexcept = default;
+
+    void* allocate(std::size_t s, std::size_t alignment, arena_tag tag = default_tag) {
+        bool pristine;
+        return allocate_impl(s, alignment, tag, false, pristine);
+    }
+
+    // allocate and report whether the block is pristine (reads as zero)
+    // pristine blocks are preferred over recycled ones within a slab
+    void* allocate_pristine(std::size_t s, std::size_t alignment, bool& pristine, arena_tag tag = default_tag) {
+        return allocate_impl(s, alignment, tag, true, pristine);
+    }
+
+    void deallocate(void* ptr, std::size_t, std::size_t) {
+        if (!ptr) return;
+        const auto i = page_index(ptr);
+        if (_pages[i].state == page_state::slab) deallocate_small(_pages[i].slab, ptr);
+        else free_block(i, _pages[i].order);
+    }
+
+    // number of bytes available in the block at ptr
+    std::size_t usable_size(const void* ptr) const noexcept {
+        if (!ptr) return 0u;
+        const auto i = page_index(ptr);
+        const auto& p = _pages[i];
+        if (p.state == page_state::slab) return _slabs[p.slab].block_size;
+        return (page_size << p.order) - color_offset(ptr, i);
+    }
+
+    // grow or shrink a block without moving it
+    // - blocks from slabs can use the slack of their class
+    // - large blocks shrink by returning upper halves to the page heap, and grow by absorbing
+    //   their free buddies (the block stays aligned to its new size)
+    bool try_resize(void* ptr, std::size_t new_size) noexcept {
+        if (!ptr) return false;
+        const auto n = std::max(new_size, min_block_size);
+        const auto i = page_index(ptr);
+        if (_pages[i].state == page_state::slab) return n <= _slabs[_pages[i].slab].block_size;
+        const std::size_t k = _pages[i].order;
+        const auto order = page_order(n + color_offset(ptr, i));
+        if (order > max_order) return false;
+        if (order < k) shrink_block(i, k, order);
+        else if (order > k && !grow_block(i, k, order)) return false;
+        return true;
+    }
+
+    bool owns(const void* ptr) const noexcept {
+        const auto p = static_cast<const unsigned char*>(ptr);
+        return p >= _base && p < _base + _num_pages * page_size;
+    }
+
+    std::size_t num_pages() const noexcept { return _num_pages; }
+
+    // largest block the page heap can hold when all memory is free
+    std::size_t max_size() const noexcept { return max_block_size(_base, _num_pages * page_size); }
+
+    // largest block the page heap of an arena on [ptr, ptr+size) can hold
+    static std::size_t max_block_size(const void* ptr, std::size_t size) noexcept {
+        const auto addr = reinterpret_cast<std::uintptr_t>(ptr);
+        const auto first = (addr + page_size - 1) / page_size;
+        const auto last = (addr + size) / page_size;
+        for (auto k = max_order + 1; k-- > 0;) {
+            const auto n = std::size_t{1} << k;
+            if ((first + n - 1) / n * n + n <= last) return page_size << k;
+        }
+        return 0u;
+    }
+
+    // end of the memory managed by the arena
+    void* end() const noexcept { return page_address(_num_pages); }
+
+    // add the memory from end() up to `end` to the page heap, e.g. after it was committed
+    void extend(void* end, bool zeroed = false) {
+        const auto addr = reinterpret_cast<std::uintptr_t>(end);
+        if (addr / page_size <= _base_pfn + _num_pages) return;
+        const auto first = _num_pages;
+        _num_pages = addr / page_size - _base_pfn;
+        _pages.resize(_num_pages);
+
+        // decompose the range into maximal naturally aligned blocks and insert them in reverse
+        // order, such that the lowest addresses are handed out first
+        std::vector<std::pair<std::size_t, std::size_t>> blocks;
+        for (std::size_t i = first; i < _num_pages;) {
+            std::size_t k = 0;
+            while (k < max_order && ((_base_pfn + i) & ((std::size_t{2} << k) - 1)) == 0 &&
+                   i + (std::size_t{2} << k) <= _num_pages)
+                ++k;
+            blocks.emplace_back(i, k);
+            i += std::size_t{1} << k;
+        }
+        for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) free_block(it->first, it->second, zeroed);
+    }
+
+    // after a failed request, add just enough memory below `limit` for its block and retry
+    // - commit(ptr, n) makes [ptr, ptr+n) available (e.g. commits it) and returns false otherwise
+    // - the block is formed with the free pages at the end, if they start at a suitable boundary,
+    //   and from fresh memory otherwise
+    // - small requests aim for a whole slab, if it fits
+    template<typename Commit, typename Allocate>
+    void* grow(std::size_t s, std::size_t alignment, const void* limit, bool zeroed, Commit&& commit,
+        Allocate&& allocate) {
+        const auto n = std::max(s, alignment);
+        if (n > (page_size << max_order)) return nullptr;
+        const auto top = reinterpret_cast<std::uintptr_t>(limit);
+        const auto e = static_cast<unsigned char*>(end());
+        const auto addr = reinterpret_cast<std::uintptr_t>(e);
+        for (const auto size : {n <= max_exact_size ? n * 16 : n, n}) {
+            const auto b = page_size << page_order(size);
+            auto first = addr / b * b;
+            if (!free_from(first)) first += b;
+            if (first > top || b > top - first) continue;
+            if (!commit(e, first + b - addr)) continue;
+            extend(reinterpret_cast<void*>(first + b), zeroed);
+            return allocate();
+        }
+        return nullptr;
+    }
+
+    // remove the free pages at the end from the page heap, such that the memory beyond end() can
+    // be decommitted; empty slabs are released first
+    void* truncate() {
+        release_empty_slabs();
+        // find the end of the last block in use
+        std::size_t last = 0u;
+        for (std::size_t i = 0; i < _num_pages;) {
+            const auto& p = _pages[i];
+            std::size_t n = 1u;
+            if (p.state == page_state::slab) n = _slabs[p.slab].first_page + (std::size_t{1} << _slabs[p.slab].order) - i;
+            else if (p.state != page_state::none) n = std::size_t{1} << p.order;
+            if (p.state != page_state::free) last = i + n;
+            i += n;
+        }
+        for (auto i = last; i < _num_pages; i += std::size_t{1} << _pages[i].order) unlink_block(i, _pages[i].order);
+        _num_pages = last;
+        _pages.resize(_num_pages);
+        return end();
+    }
+
+    // current exact-fit classes
+    size_class_table size_classes() const {
+        size_class_table t;
+        for (auto e : _exact)
+            if (e) t.sizes.push_back(e);
+        return t;
+    }
+
+    // replace the exact-fit classes: slabs of replaced classes keep serving their blocks until
+    // they are empty and are then returned to the page heap
+    void set_size_classes(const size_class_table& t) {
+        std::vector<std::size_t> sizes;
+        const auto granule = _config.cache_line_padding ? cache_line_size : min_block_size;
+        for (auto e : t.sizes) {
+            e = (std::max(e, min_block_size) + granule - 1) / granule * granule;
+            if (e <= max_exact_size && !std::has_single_bit(e)) sizes.push_back(e);
+        }
+        std::sort(sizes.begin(), sizes.end());
+        sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+        if (sizes.size() > max_exact_classes) sizes.resize(max_exact_classes);
+
+        std::array<std::size_t, max_exact_classes> exact;
+        exact.fill(0u);
+        std::copy(sizes.begin(), sizes.end(), exact.begin());
+        for (std::size_t j = 0; j < max_exact_classes; ++j) {
+            if (exact[j] == _exact[j]) continue;
+            for (auto& p : _partial)
+                while (p[num_classes + j] != npos) retire_slab(p[num_classes + j]);
+        }
+        _exact = exact;
+        _num_exact = sizes.size();
+        update_lookup();
+    }
+
+    // build exact-fit classes from the sizes sampled so far
+    void rebuild_size_classes() {
+        std::vector<std::pair<std::size_t, std::size_t>> counts(_histogram.begin(), _histogram.end());
+        std::sort(counts.begin(), counts.end(), [](auto const& a, auto const& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        size_class_table t;
+        for (auto [size, count] : counts) {
+            if (count < _config.hot_fraction * _num_samples || t.sizes.size() == max_exact_classes) break;
+            // power of two sizes are served exactly by the regular classes already
+            if (!std::has_single_bit(size)) t.sizes.push_back(size);
+        }
+        _histogram.clear();
+        _num_samples = 0u;
+        set_size_classes(t);
+    }
+
+    // decommit free pages which are not pristine through `decommit(ptr, n)`, which returns whether
+    // the pages read as zero afterwards; cached empty slabs are released first
+    // returns the number of decommitted bytes
+    template<typename Decommit>
+    std::size_t trim(Decommit&& decommit) {
+        release_empty_slabs();
+        std::size_t bytes = 0u;
+        for (std::size_t k = 0; k <= max_order; ++k) {
+            for (auto i = _free_blocks[k]; i != npos; i = _pages[i].next) {
+                if (_pages[i].pristine || !decommit(page_address(i), page_size << k)) continue;
+                _pages[i].pristine = true;
+                bytes += page_size << k;
+            }
+        }
+        return bytes;
+    }
+
+    // return cached empty slabs to the page heap, such that their pages can be used by other
+    // classes or large blocks
+    bool release_empty_slabs() noexcept {
+        bool released = false;
+        for (auto& p : _partial) {
+            for (auto si : p) {
+                if (si != npos && _slabs[si].used == 0) {
+                    release_slab(si);
+                    released = true;
+                }
+            }
+        }
+        return released;
+    }
+
+  private:
+    void* allocate_impl(std::size_t s, std::size_t alignment, arena_tag tag, bool prefer_pristine, bool& pristine) {
+        pristine = false;
+        // tags beyond the supported ones are rejected rather than merged with others
+        if (tag >= num_arena_tags) return nullptr;
+        auto n = std::max({s, alignment, min_block_size});
+        // too large for any block (and checked before padding, which would overflow)
+        if (n > (page_size << max_order)) return nullptr;
+        if (_config.cache_line_padding) n = (n + cache_line_size - 1) / cache_line_size * cache_line_size;
+        if (alignment <= min_block_size && n <= max_exact_size) {
+            if (_config.adaptive) sample(n);
+            if (n <= max_small_size) return allocate_small(_class_of[lookup_index(n)], tag, prefer_pristine, pristine);
+            if (const auto cls = exact_class(n); cls != npos) return allocate_small(cls, tag, prefer_pristine, pristine);
+        }
+        else if (n <= max_small_size)
+            return allocate_small(size_class(n), tag, prefer_pristine, pristine);
+        const auto order = page_order(n);
+        if (order > max_order) return nullptr;
+        // color within the slack of the block, such that it does not need a larger order (exact
+        // power of two sizes are not colored); over-aligned blocks are not colored
+        const auto slack = (page_size << order) - n;
+        const auto offset = alignment <= min_block_size ?
+            next_color(std::min(_config.num_colors, slack / cache_line_size + 1)) : 0u;
+        auto i = allocate_block(order);
+        if (i == npos && release_empty_slabs()) i = allocate_block(order);
+        if (i == npos) return nullptr;
+        _pages[i].state = page_state::used;
+        pristine = std::exchange(_pages[i].pristine, false);
+        return page_address(i) + offset;
+    }
+
+    // power of two size class index of a (small) block size
+    static std::size_t size_class(std::size_t n) noexcept {
+        return std::bit_width(n - 1) - std::countr_zero(min_block_size);
+    }
+
+    static std::size_t lookup_index(std::size_t n) noexcept { return (n + min_block_size - 1) / min_block_size; }
+
+    std::size_t class_size(std::size_t cls) const noexcept {
+        return cls < num_classes ? min_block_size << cls : _exact[cls - num_classes];
+    }
+
+    // smallest exact-fit class which holds n bytes and is tighter than a power of two block
+    std::uint32_t exact_class(std::size_t n) const noexcept {
+        const auto limit = n <= max_small_size ? std::bit_ceil(n) : page_size << page_order(n);
+        for (std::size_t j = 0; j < _num_exact; ++j)
+            if (_exact[j] >= n) return _exact[j] < limit ? static_cast<std::uint32_t>(num_classes + j) : npos;
+        return npos;
+    }
+
+    void update_lookup() noexcept {
+        _class_of[0] = 0;
+        for (std::size_t i = 1; i < num_lookup; ++i) {
+            const auto n = i * min_block_size;
+            const auto cls = exact_class(n);
+            _class_of[i] = static_cast<std::uint8_t>(cls != npos ? cls : size_class(n));
+        }
+    }
+
+    void sample(std::size_t n) {
+        if (++_tick < _config.sample_period) return;
+        _tick = 0u;
+        ++_histogram[lookup_index(n) * min_block_size];
+        if (++_num_samples >= _config.rebuild_period) rebuild_size_classes();
+    }
+
+    // buddy order needed to hold n bytes
+    static std::size_t page_order(std::size_t n) noexcept {
+        return std::bit_width((n + page_size - 1) / page_size - 1);
+    }
+
+    // preferred slab order for a size class: room for at least 16 blocks
+    std::size_t slab_order(std::size_t cls) const noexcept { return page_order(class_size(cls) * 16); }
+
+    unsigned char* page_address(std::size_t i) const noexcept { return _base + i * page_size; }
+
+    // whether the memory from addr to end() belongs to the page heap and is free
+    bool free_from(std::uintptr_t addr) const noexcept {
+        if (addr < reinterpret_cast<std::uintptr_t>(_base)) return false;
+        for (auto i = (addr - reinterpret_cast<std::uintptr_t>(_base)) / page_size; i < _num_pages;
+             i += std::size_t{1} << _pages[i].order)
+            if (_pages[i].state != page_state::free) return false;
+        return true;
+    }
+
+    // offset of a (colored) large block from the start of its first page
+    std::size_t color_offset(const void* ptr, std::size_t i) const noexcept {
+        return static_cast<std::size_t>(static_cast<const unsigned char*>(ptr) - page_address(i));
+    }
+
+    // offset in bytes of the next color out of `colors`
+    std::size_t next_color(std::size_t colors) noexcept {
+        if (colors <= 1u) return 0u;
+        return (_color++ % colors) * cache_line_size;
+    }
+
+    std::size_t page_index(const void* ptr) const noexcept {
+        return (static_cast<const unsigned char*>(ptr) - _base) / page_size;
+    }
+
+    void link_block(std::size_t i, std::size_t k) noexcept {
+        auto& p = _pages[i];
+        p.state = page_state::free;
+        p.order = static_cast<std::uint8_t>(k);
+        p.prev = npos;
+        p.next = _free_blocks[k];
+        if (p.next != npos) _pages[p.next].prev = static_cast<std::uint32_t>(i);
+        _free_blocks[k] = static_cast<std::uint32_t>(i);
+    }
+
+    void unlink_block(std::size_t i, std::size_t k) noexcept {
+        auto& p = _pages[i];
+        if (p.prev != npos) _pages[p.prev].next = p.next;
+        else _free_blocks[k] = p.next;
+        if (p.next != npos) _pages[p.next].prev = p.prev;
+        p.prev = p.next = npos;
+        p.state = page_state::none;
+    }
+
+    std::uint32_t allocate_block(std::size_t order) noexcept {
+        auto k = order;
+        while (k <= max_order && _free_blocks[k] == npos) ++k;
+        if (k > max_order) return npos;
+        const auto i = _free_blocks[k];
+        unlink_block(i, k);
+        // split and return the upper halves to the free lists
+        while (k > order) {
+            --k;
+            link_block(i + (std::size_t{1} << k), k);
+            _pages[i + (std::size_t{1} << k)].pristine = _pages[i].pristine;
+        }
+        _pages[i].order = static_cast<std::uint8_t>(order);
+        return i;
+    }
+
+    void free_block(std::size_t i, std::size_t k, bool pristine = false) noexcept {
+        _pages[i].state = page_state::none;
+        // coalesce with free buddies
+        while (k < max_order) {
+            const auto buddy_pfn = (_base_pfn + i) ^ (std::size_t{1} << k);
+            if (buddy_pfn < _base_pfn) break;
+            const auto j = buddy_pfn - _base_pfn;
+            if (j + (std::size_t{1} << k) > _num_pages) break;
+            if (_pages[j].state != page_state::free || _pages[j].order != k) break;
+            unlink_block(j, k);
+            pristine = pristine && _pages[j].pristine;
+            i = std::min(i, j);
+            ++k;
+        }
+        link_block(i, k);
+        _pages[i].pristine = pristine;
+    }
+
+    void shrink_block(std::size_t i, std::size_t k, std::size_t order) noexcept {
+        while (k > order) {
+            --k;
+            free_block(i + (std::size_t{1} << k), k);
+        }
+        _pages[i].order = static_cast<std::uint8_t>(order);
+    }
+
+    bool grow_block(std::size_t i, std::size_t k, std::size_t order) noexcept {
+        // all upper buddies up to the requested order must be free
+        for (auto j = k; j < order; ++j) {
+            if (((_base_pfn + i) & ((std::size_t{2} << j) - 1)) != 0) return false;
+            const auto b = i + (std::size_t{1} << j);
+            if (b + (std::size_t{1} << j) > _num_pages) return false;
+            if (_pages[b].state != page_state::free || _pages[b].order != j) return false;
+        }
+        for (auto j = k; j < order; ++j) unlink_block(i + (std::size_t{1} << j), j);
+        _pages[i].order = static_cast<std::uint8_t>(order);
+        return true;
+    }
+
+    void link_slab(std::uint32_t si) noexcept {
+        auto& s = _slabs[si];
+        s.prev = npos;
+        s.next = _partial[s.tag][s.cls];
+        if (s.next != npos) _slabs[s.next].prev = si;
+        _partial[s.tag][s.cls] = si;
+    }
+
+    void unlink_slab(std::uint32_t si) noexcept {
+        auto& s = _slabs[si];
+        if (s.prev != npos) _slabs[s.prev].next = s.next;
+        else _partial[s.tag][s.cls] = s.next;
+        if (s.next != npos) _slabs[s.next].prev = s.prev;
+        s.prev = s.next = npos;
+    }
+
+    std::uint32_t new_slab(std::size_t cls, arena_tag tag) {
+        // fall back to smaller slabs, and to pages of empty slabs of other classes, when memory is
+        // tight
+        const auto min_k = page_order(class_size(cls));
+        auto k = slab_order(cls);
+        auto i = allocate_block(k);
+        while (i == npos && k > min_k) i = allocate_block(--k);
+        if (i == npos && release_empty_slabs()) i = allocate_block(k);
+        if (i == npos) return npos;
+
+        std::uint32_t si = _free_slabs;
+        if (si != npos) _free_slabs = _slabs[si].next;
+        else {
+            si = static_cast<std::uint32_t>(_slabs.size());
+            _slabs.emplace_back();
+        }
+        auto& s = _slabs[si];
+        s = slab{};
+        s.base = page_address(i);
+        s.block_size = static_cast<std::uint32_t>(class_size(cls));
+        s.capacity = static_cast<std::uint32_t>((page_size << k) / s.block_size);
+        // color exact-fit slabs within their slack (regular classes have none and must stay
+        // naturally aligned)
+        if (cls >= num_classes) {
+            const auto slack = (page_size << k) - std::size_t{s.capacity} * s.block_size;
+            s.base += next_color(std::min(_config.num_colors, slack / cache_line_size + 1));
+        }
+        s.first_page = i;
+        s.order = static_cast<std::uint8_t>(k);
+        s.cls = static_cast<std::uint8_t>(cls);
+        s.tag = tag;
+        s.pristine = std::exchange(_pages[i].pristine, false);
+        for (std::size_t j = i; j < i + (std::size_t{1} << k); ++j) {
+            _pages[j].state = page_state::slab;
+            _pages[j].slab = si;
+        }
+        link_slab(si);
+        return si;
+    }
+
+    bool is_linked(std::uint32_t si) const noexcept {
+        return _slabs[si].prev != npos || _partial[_slabs[si].tag][_slabs[si].cls] == si;
+    }
+
+    // detach a slab from its class, it is released once empty
+    void retire_slab(std::uint32_t si) noexcept {
+        if (is_linked(si)) unlink_slab(si);
+        _slabs[si].retired = true;
+        if (_slabs[si].used == 0) release_slab(si);
+    }
+
+    void release_slab(std::uint32_t si) noexcept {
+        if (is_linked(si)) unlink_slab(si);
+        auto& s = _slabs[si];
+        for (std::size_t j = s.first_page; j < s.first_page + (std::size_t{1} << s.order); ++j) {
+            _pages[j].state = page_state::none;
+            _pages[j].slab = npos;
+        }
+        free_block(s.first_page, s.order);
+        s.next = _free_slabs;
+        _free_slabs = si;
+    }
+
+    void* allocate_small(std::size_t cls, arena_tag tag, bool prefer_pristine, bool& pristine) {
+        pristine = false;
+        auto si = _partial[tag][cls];
+        if (si == npos) si = new_slab(cls, tag);
+        if (si == npos) return nullptr;
+        auto& s = _slabs[si];
+        void* ptr;
+        if (s.free && !(prefer_pristine && s.pristine && s.bump < s.capacity)) {
+            ptr = s.free;
+            s.free = *static_cast<void**>(ptr);
+        }
+        else {
+            ptr = s.base + std::size_t{s.bump++} * s.block_size;
+            pristine = s.pristine;
+        }
+        if (++s.used == s.capacity) unlink_slab(si);
+        return ptr;
+    }
+
+    void deallocate_small(std::uint32_t si, void* ptr) noexcept {
+        auto& s = _slabs[si];
+        // full slabs of replaced classes are not in any list and are detected here
+        if (!s.retired && s.block_size != class_size(s.cls)) s.retired = true;
+        *static_cast<void**>(ptr) = s.free;
+        s.free = ptr;
+        if (s.retired) {
+            if (--s.used == 0) release_slab(si);
+            return;
+        }
+        if (s.used == s.capacity) link_slab(si);
+        // keep the last partial slab of a class around to avoid thrashing
+        if (--s.used == 0 && (s.prev != npos || s.next != npos)) release_slab(si);
+    }
+};
+
+} // namespace detail
+} // namespace hwmalloc2
@@ -0,0 +1,58 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HWMALLOC2_HAVE_X86_CLEAR_KERNELS 1
+#endif
+
+namespace hwmalloc2 {
+namespace detail {
+
+// buffers of at least this size are cleared with non-temporal stores
+inline constexpr std::size_t nt_clear_threshold = std::size_t{1} << 20;
+
+#if defined(HWMALLOC2_HAVE_X86_CLEAR_KERNELS)
+__attribute__((target("avx2"))) inline void clear_avx2(unsigned char* d, std::size_t n) noexcept {
+    const std::size_t head = (32u - (reinterpret_cast<std::uintptr_t>(d) & 31u)) & 31u;
+    std::memset(d, 0, head);
+    d += head;
+    n -= head;
+    const auto z = _mm256_setzero_si256();
+    for (; n >= 128; n -= 128, d += 128) {
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d), z);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 32), z);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 64), z);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 96), z);
+    }
+    for (; n >= 32; n -= 32, d += 32) _mm256_stream_si256(reinterpret_cast<__m256i*>(d), z);
+    std::memset(d, 0, n);
+    _mm_sfence();
+}
+#endif
+
+// zero n bytes: large buffers are cleared without pulling them into the cache
+inline void clear(void* ptr, std::size_t n) noexcept {
+#if defined(HWMALLOC2_HAVE_X86_CLEAR_KERNELS)
+    if (n >= nt_clear_threshold && __builtin_cpu_supports("avx2")) {
+        clear_avx2(static_cast<unsigned char*>(ptr), n);
+        return;
+    }
+#endif
+    std::memset(ptr, 0, n);
+}
+
+} // namespace detail
+} // namespace hwmalloc2
@@ -0,0 +1,85 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#if defined(RSEQ_SIG) && defined(__has_builtin)
+#if __has_builtin(__builtin_thread_pointer)
+#define HWMALLOC2_HAVE_RSEQ 1
+#endif
+#endif
+#endif
+#elif defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace hwmalloc2 {
+namespace detail {
+
+// number of online cpus (at least 1)
+inline std::size_t num_cpus() noexcept {
+#if defined(_SC_NPROCESSORS_ONLN)
+    const long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) return static_cast<std::size_t>(n);
+#endif
+    const auto n_hw = std::thread::hardware_concurrency();
+    return n_hw > 0 ? n_hw : 1u;
+}
+
+// cpu the calling thread currently runs on
+// - reads the restartable sequences area which glibc registers for every thread (no system call)
+// - falls back to sched_getcpu, and to a hash of the thread id where neither is available
+// the result is a hint only: the thread may migrate right after the call
+inline std::size_t current_cpu() noexcept {
+#if defined(HWMALLOC2_HAVE_RSEQ)
+    if (__rseq_size > 0) {
+        const auto rs = reinterpret_cast<const volatile struct rseq*>(
+            static_cast<const char*>(__builtin_thread_pointer()) + __rseq_offset);
+        const auto cpu = static_cast<int>(rs->cpu_id);
+        if (cpu >= 0) return static_cast<std::size_t>(cpu);
+    }
+#endif
+#if defined(__linux__)
+    const int cpu = ::sched_getcpu();
+    if (cpu >= 0) return static_cast<std::size_t>(cpu);
+#endif
+    thread_local const std::size_t id = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    return id;
+}
+
+// test-and-test-and-set lock for short critical sections
+class spin_mutex {
+    std::atomic<bool> _locked{false};
+
+  public:
+    bool try_lock() noexcept {
+        return !_locked.load(std::memory_order_relaxed) && !_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void lock() noexcept {
+        while (!try_lock()) {
+            while (_locked.load(std::memory_order_relaxed)) std::this_thread::yield();
+        }
+    }
+
+    void unlock() noexcept { _locked.store(false, std::memory_order_release); }
+};
+
+} // namespace detail
+} // namespace hwmalloc2
@@ -0,0 +1,48 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace hwmalloc2 {
+namespace detail {
+
+// optional capabilities of memory resources, with defaults for resources which lack them
+
+// whether the memory reads as zero initially
+template<typename R>
+inline bool zero_initialized(const R& r) noexcept {
+    if constexpr (requires { r.zero_initialized(); }) return r.zero_initialized();
+    else return false;
+}
+
+// release the physical pages backing [ptr, ptr+n), returns true if they read as zero afterwards
+template<typename R>
+inline bool decommit(R& r, void* ptr, std::size_t n) noexcept {
+    if constexpr (requires { r.decommit(ptr, n); }) return r.decommit(ptr, n);
+    else return false;
+}
+
+// number of bytes at the start of the memory which are backed (reserved memory commits on demand)
+template<typename R>
+inline std::size_t committed(const R& r) noexcept {
+    if constexpr (requires { r.committed(); }) return r.committed();
+    else return r.size();
+}
+
+// make sure [ptr, ptr+n) is backed by memory before it is handed out (reserved memory)
+template<typename R>
+inline bool commit(R& r, void* ptr, std::size_t n) noexcept {
+    if constexpr (requires { r.commit(ptr, n); }) return r.commit(ptr, n);
+    else return true;
+}
+
+} // namespace detail
+} // namespace hwmalloc2
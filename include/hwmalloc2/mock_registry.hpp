@@ -0,0 +1,200 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc2/concepts.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace hwmalloc2 {
+
+namespace detail {
+
+// burn cpu time, like a driver pinning pages would
+inline void spin_for(std::chrono::nanoseconds d) noexcept {
+    if (d <= std::chrono::nanoseconds::zero()) return;
+    const auto end = std::chrono::steady_clock::now() + d;
+    while (std::chrono::steady_clock::now() < end) {}
+}
+
+} // namespace detail
+
+// costs and limits of the simulated network interface
+struct mock_registry_config {
+    // fixed cost of a registration and a deregistration
+    std::chrono::nanoseconds registration_latency{0};
+    std::chrono::nanoseconds deregistration_latency{0};
+    // additional registration cost per (started) page
+    std::chrono::nanoseconds per_page_cost{0};
+    // cost of a key look-up
+    std::chrono::nanoseconds lookup_cost{0};
+    // number of registrations which may be active at the same time
+    std::size_t max_registrations = std::numeric_limits<std::size_t>::max();
+    std::size_t page_size = 4096u;
+    // registrations follow changes of the page tables (on demand paging), such that registered
+    // memory may be decommitted
+    bool on_demand_paging = false;
+};
+
+// snapshot of the counters of a mock_registry
+struct mock_registry_counters {
+    std::size_t registrations = 0u;
+    std::size_t deregistrations = 0u;
+    std::size_t failed_registrations = 0u;
+    std::size_t active_registrations = 0u;
+    std::size_t pinned_bytes = 0u;
+    std::size_t peak_pinned_bytes = 0u;
+    std::size_t registered_bytes = 0u;  // total over all registrations
+    std::size_t lookups = 0u;
+};
+
+// simulated network interface registry which models the cost of registration, deregistration and
+// key look-up as well as a limited number of registration slots, and counts what happened
+// - registration costs are simulated by busy waiting on the calling thread
+// - registering when all slots are taken throws std::runtime_error
+// - regions deregister on destruction
+// thread safe; the registry must outlive its regions
+class mock_registry {
+  public:
+    struct key {
+        std::uint32_t lkey;
+        std::uint32_t rkey;
+    };
+
+    class region {
+        friend class mock_registry;
+
+        mock_registry* _registry = nullptr;
+        void*          _ptr = nullptr;
+        std::size_t    _size = 0u;
+        std::uint32_t  _id = 0u;
+
+        region(mock_registry* r, void* ptr, std::size_t s, std::uint32_t id) noexcept
+        : _registry{r}, _ptr{ptr}, _size{s}, _id{id} {}
+
+      public:
+        region(region&& other) noexcept
+        : _registry{std::exchange(other._registry, nullptr)}
+        , _ptr{other._ptr}
+        , _size{other._size}
+        , _id{other._id}
+        {}
+
+        region& operator=(region&& other) noexcept {
+            if (this != &other) {
+                if (_registry) _registry->deregister(_size);
+                _registry = std::exchange(other._registry, nullptr);
+                _ptr = other._ptr;
+                _size = other._size;
+                _id = other._id;
+            }
+            return *this;
+        }
+
+        ~region() {
+            if (_registry) _registry->deregister(_size);
+        }
+
+        void* data() const noexcept { return _ptr; }
+
+        std::size_t size() const noexcept { return _size; }
+
+        bool on_demand_paging() const noexcept { return _registry && _registry->_config.on_demand_paging; }
+
+        key get_key(void*, std::size_t) const {
+            _registry->_lookups.fetch_add(1u, std::memory_order_relaxed);
+            detail::spin_for(_registry->_config.lookup_cost);
+            return {_id, _id};
+        }
+    };
+
+  private:
+    mock_registry_config     _config;
+    std::atomic<std::size_t> _registrations{0u};
+    std::atomic<std::size_t> _deregistrations{0u};
+    std::atomic<std::size_t> _failed_registrations{0u};
+    std::atomic<std::size_t> _active{0u};
+    std::atomic<std::size_t> _pinned_bytes{0u};
+    std::atomic<std::size_t> _peak_pinned_bytes{0u};
+    std::atomic<std::size_t> _registered_bytes{0u};
+    mutable std::atomic<std::size_t> _lookups{0u};
+    std::atomic<std::uint32_t> _next_id{1u};
+
+  public:
+    mock_registry(const mock_registry_config& config = {}) : _config{config} {}
+
+    mock_registry(const mock_registry&) = delete;
+    mock_registry& operator=(const mock_registry&) = delete;
+
+    region register_memory(void* ptr, std::size_t s) {
+        // claim a slot
+        auto active = _active.load(std::memory_order_relaxed);
+        do {
+            if (active >= _config.max_registrations) {
+                _failed_registrations.fetch_add(1u, std::memory_order_relaxed);
+                throw std::runtime_error("mock_registry: out of registration slots");
+            }
+        } while (!_active.compare_exchange_weak(active, active + 1u, std::memory_order_relaxed));
+
+        const auto pages = (s + _config.page_size - 1) / _config.page_size;
+        detail::spin_for(_config.registration_latency + pages * _config.per_page_cost);
+
+        _registrations.fetch_add(1u, std::memory_order_relaxed);
+        _registered_bytes.fetch_add(s, std::memory_order_relaxed);
+        const auto pinned = _pinned_bytes.fetch_add(s, std::memory_order_relaxed) + s;
+        auto peak = _peak_pinned_bytes.load(std::memory_order_relaxed);
+        while (peak < pinned && !_peak_pinned_bytes.compare_exchange_weak(peak, pinned, std::memory_order_relaxed)) {}
+
+        return {this, ptr, s, _next_id.fetch_add(1u, std::memory_order_relaxed)};
+    }
+
+    const mock_registry_config& config() const noexcept { return _config; }
+
+    mock_registry_counters counters() const noexcept {
+        mock_registry_counters c;
+        c.registrations = _registrations.load(std::memory_order_relaxed);
+        c.deregistrations = _deregistrations.load(std::memory_order_relaxed);
+        c.failed_registrations = _failed_registrations.load(std::memory_order_relaxed);
+        c.active_registrations = _active.load(std::memory_order_relaxed);
+        c.pinned_bytes = _pinned_bytes.load(std::memory_order_relaxed);
+        c.peak_pinned_bytes = _peak_pinned_bytes.load(std::memory_order_relaxed);
+        c.registered_bytes = _registered_bytes.load(std::memory_order_relaxed);
+        c.lookups = _lookups.load(std::memory_order_relaxed);
+        return c;
+    }
+
+    // reset the cumulative counters (active registrations and pinned bytes are kept)
+    void reset_counters() noexcept {
+        _registrations.store(0u, std::memory_order_relaxed);
+        _deregistrations.store(0u, std::memory_order_relaxed);
+        _failed_registrations.store(0u, std::memory_order_relaxed);
+        _registered_bytes.store(0u, std::memory_order_relaxed);
+        _lookups.store(0u, std::memory_order_relaxed);
+        _peak_pinned_bytes.store(_pinned_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+  private:
+    void deregister(std::size_t s) noexcept {
+        detail::spin_for(_config.deregistration_latency);
+        _deregistrations.fetch_add(1u, std::memory_order_relaxed);
+        _pinned_bytes.fetch_sub(s, std::memory_order_relaxed);
+        _active.fetch_sub(1u, std::memory_order_release);
+    }
+};
+
+static_assert(Registry<mock_registry>);
+
+} // namespace hwmalloc2
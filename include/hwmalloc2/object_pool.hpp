@@ -0,0 +1,180 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc2/arena_config.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace hwmalloc2 {
+
+// pool of fixed size objects of type T, drawing chunks of memory from a resource
+// - every object lives in its own cache line aligned slot
+// - free slots are kept in an intrusive list (allocation and release are a pop and a push)
+// - the key of each slot is obtained from the resource once, when its chunk is created, and stored
+//   next to the object: look-ups do not go back to the resource
+// the pool references the resource, which must outlive it, and is not thread safe
+// objects which are still alive when the pool is destroyed are not destroyed
+template<typename T, typename Resource>
+class object_pool {
+  public:
+    using value_type = T;
+    using key_type = std::decay_t<decltype(std::declval<Resource&>().get_key(nullptr, 0u))>;
+
+    struct handle {
+        T*       ptr;
+        key_type key;
+    };
+
+  private:
+    struct node {
+        node* next;
+    };
+
+    static constexpr std::size_t round_up(std::size_t n, std::size_t a) noexcept { return (n + a - 1) / a * a; }
+
+    static constexpr std::size_t key_offset = round_up(std::max(sizeof(T), sizeof(node)), alignof(key_type));
+
+  public:
+    static constexpr std::size_t slot_alignment = std::max(alignof(T), cache_line_size);
+    static constexpr std::size_t slot_size = round_up(key_offset + sizeof(key_type), slot_alignment);
+
+  private:
+    Resource*          _res;
+    std::size_t        _objects_per_chunk;
+    node*              _free = nullptr;
+    std::size_t        _num_free = 0u;
+    std::vector<void*> _chunks;
+
+  public:
+    object_pool(Resource& r, std::size_t objects_per_chunk = std::max<std::size_t>(1u, 65536u / slot_size))
+    : _res{&r}
+    , _objects_per_chunk{std::max<std::size_t>(1u, objects_per_chunk)}
+    {}
+
+    object_pool(object_pool&& other) noexcept
+    : _res{other._res}
+    , _objects_per_chunk{other._objects_per_chunk}
+    , _free{std::exchange(other._free, nullptr)}
+    , _num_free{std::exchange(other._num_free, 0u)}
+    , _chunks{std::move(other._chunks)}
+    {
+        other._chunks.clear();
+    }
+
+    object_pool(const object_pool&) = delete;
+    object_pool& operator=(const object_pool&) = delete;
+    object_pool& operator=(object_pool&&) = delete;
+
+    ~object_pool() {
+        for (auto c : _chunks) {
+            for (std::size_t i = 0; i < _objects_per_chunk; ++i) std::destroy_at(key_ptr(slot(c, i)));
+            _res->deallocate(c, chunk_size(), slot_alignment);
+        }
+    }
+
+    // raw slot for one object, or nullptr if the resource is exhausted
+    T* allocate() {
+        if (!_free && !grow()) return nullptr;
+        node* n = _free;
+        _free = n->next;
+        --_num_free;
+        return reinterpret_cast<T*>(n);
+    }
+
+    // return a raw slot
+    void deallocate(T* ptr) noexcept {
+        node* n = ::new (static_cast<void*>(ptr)) node{_free};
+        _free = n;
+        ++_num_free;
+    }
+
+    // key of a slot handed out by this pool
+    static const key_type& get_key(const T* ptr) noexcept { return *key_ptr(ptr); }
+
+    // construct an object in a new slot, throws std::bad_alloc if the resource is exhausted
+    template<typename... Args>
+    handle construct(Args&&... args) {
+        T* ptr = allocate();
+        if (!ptr) throw std::bad_alloc{};
+        try {
+            ::new (static_cast<void*>(ptr)) T(std::forward<Args>(args)...);
+        }
+        catch (...) {
+            deallocate(ptr);
+            throw;
+        }
+        return {ptr, get_key(ptr)};
+    }
+
+    void destroy(T* ptr) noexcept {
+        std::destroy_at(ptr);
+        deallocate(ptr);
+    }
+
+    void destroy(const handle& h) noexcept { destroy(h.ptr); }
+
+    // construct n objects from the same arguments and write their handles to `out`
+    // chunks for all objects are obtained up front; throws std::bad_alloc (before constructing
+    // anything) if the resource is exhausted, objects constructed before a throwing constructor
+    // have already been written to `out`
+    template<typename OutputIt, typename... Args>
+    OutputIt construct_n(std::size_t n, OutputIt out, const Args&... args) {
+        if (!reserve(n)) throw std::bad_alloc{};
+        for (std::size_t i = 0; i < n; ++i) *out++ = construct(args...);
+        return out;
+    }
+
+    // destroy a range of objects, given as pointers or handles
+    template<typename InputIt>
+    void destroy_n(InputIt first, std::size_t n) noexcept {
+        for (std::size_t i = 0; i < n; ++i, ++first) destroy(*first);
+    }
+
+    // make sure at least n slots are available without going back to the resource
+    bool reserve(std::size_t n) {
+        while (_num_free < n)
+            if (!grow()) return false;
+        return true;
+    }
+
+    std::size_t num_free() const noexcept { return _num_free; }
+
+  private:
+    std::size_t chunk_size() const noexcept { return _objects_per_chunk * slot_size; }
+
+    static void* slot(void* chunk, std::size_t i) noexcept { return static_cast<unsigned char*>(chunk) + i * slot_size; }
+
+    static key_type* key_ptr(const void* s) noexcept {
+        return reinterpret_cast<key_type*>(const_cast<unsigned char*>(static_cast<const unsigned char*>(s)) + key_offset);
+    }
+
+    bool grow() {
+        void* c = _res->allocate(chunk_size(), slot_alignment);
+        if (!c) return false;
+        _chunks.push_back(c);
+        // bulk initialization: keys are looked up once and slots are linked in address order
+        for (std::size_t i = _objects_per_chunk; i-- > 0;) {
+            void* s = slot(c, i);
+            ::new (static_cast<void*>(key_ptr(s))) key_type(_res->get_key(s, sizeof(T)));
+            _free = ::new (s) node{_free};
+        }
+        _num_free += _objects_per_chunk;
+        return true;
+    }
+};
+
+} // namespace hwmalloc2
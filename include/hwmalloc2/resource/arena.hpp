@@ -9,56 +9,143 @@
  */
 #pragma once
 
+#include <hwmalloc2/allocation_result.hpp>
+#include <hwmalloc2/arena_config.hpp>
+#include <hwmalloc2/detail/arena_impl.hpp>
+#include <hwmalloc2/detail/clear.hpp>
+#include <hwmalloc2/detail/memory_hooks.hpp>
+
+#include <algorithm>
 #include <cstddef>
 #include <memory>
 
 namespace hwmalloc2 {
 namespace res {
 
+template<typename Arena>
+class tagged_view;
+
+// sub-allocates from the memory of the nested resource
+// all blocks are naturally aligned (see detail::arena_impl): over-aligned requests, such as page or
+// huge page aligned buffers, are served without padding or headers
+// with arena_config::adaptive set, frequently requested sizes get exact-fit classes at runtime
+// small allocations can be tagged (see arena_tag) to keep allocations with different lifetimes apart
+// on reserved memory, the arena starts out with the committed memory, commits more when it runs out
+// and gives the unused end back on trim
 template<typename Resource>
 struct arena : public Resource {
 
-    arena(Resource&& r)
+    detail::arena_impl _arena;
+
+    arena(Resource&& r, const arena_config& config = {})
     : Resource{std::move(r)}
-    {
-        // arena construction
-    }
+    , _arena{this->data(), detail::committed(*this), config, detail::zero_initialized(*this)}
+    {}
 
     arena(arena&&) noexcept = default;
 
-    ~arena() {
-        // arena cleanup
+    void* allocate(std::size_t s, std::size_t alignment = alignof(std::max_align_t), arena_tag tag = default_tag) {
+        return grow_and_allocate(s, alignment, tag, [&] { return _arena.allocate(s, alignment, tag); });
     }
 
-    void* allocate(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
-        if (alignment <= alignof(std::max_align_t)) {
-            // void* ptr = arena.allocate(s); // allocate `s` from arena
-            return this->data();
-        }
-        else {
-            // std::size_t space = s + alignment + sizeof(void*) - 1;
-            // std::size_t size = s + sizeof(void*);
-            // void* ptr = ...; // allocate `space` from arena
-            // void* orig_ptr = ptr;
-            // void* aligned_ptr = std::align(alignment, size, ptr, space);
-            // ::new((unsigned char*)aligned_ptr + s) void*{orig_ptr};
-            // return aligned_ptr;
-            return this->data();
+    void deallocate(void* ptr, std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        _arena.deallocate(ptr, s, alignment);
+    }
+
+    // allocate zero initialized memory: the clear is skipped for pristine blocks
+    void* allocate_zeroed(std::size_t s, std::size_t alignment = alignof(std::max_align_t), arena_tag tag = default_tag) {
+        bool pristine;
+        void* ptr = grow_and_allocate(s, alignment, tag, [&] { return _arena.allocate_pristine(s, alignment, pristine, tag); });
+        if (ptr && !pristine) detail::clear(ptr, s);
+        return ptr;
+    }
+
+    // allocate and report the usable size of the block
+    allocation_result allocate_at_least(std::size_t s, std::size_t alignment = alignof(std::max_align_t),
+        arena_tag tag = default_tag) {
+        void* ptr = grow_and_allocate(s, alignment, tag, [&] { return _arena.allocate(s, alignment, tag); });
+        return {ptr, _arena.usable_size(ptr)};
+    }
+
+    std::size_t usable_size(const void* ptr) const noexcept { return _arena.usable_size(ptr); }
+
+    // largest request which can be served once all memory is free (also memory yet to be committed)
+    std::size_t max_size() const noexcept { return detail::arena_impl::max_block_size(this->data(), this->size()); }
+
+    // grow or shrink an allocation without moving it (the key stays valid)
+    bool try_resize_in_place(void* ptr, std::size_t /*old_size*/, std::size_t new_size) {
+        return _arena.try_resize(ptr, new_size);
+    }
+
+    // decommit free memory, if supported by the memory resource (see detail::arena_impl::trim)
+    std::size_t trim() {
+        const auto bytes = _arena.trim([this](void* p, std::size_t n) { return detail::decommit(*this, p, n); });
+        if constexpr (requires (Resource& r) { r.decommit_tail(nullptr); }) {
+            this->decommit_tail(_arena.truncate());
+            // pages which stayed committed (the tail is decommitted at a coarser granularity, and
+            // not at all on pinned or registered memory without on demand paging)
+            _arena.extend(static_cast<unsigned char*>(this->data()) + detail::committed(*this));
         }
+        return bytes;
+    }
+
+    // exact-fit classes in use, can be passed to arena_config::size_classes of a later run
+    size_class_table size_classes() const { return _arena.size_classes(); }
+
+    void rebuild_size_classes() { _arena.rebuild_size_classes(); }
+
+    // resource which allocates from this arena with the given tag
+    tagged_view<arena> view(arena_tag tag) noexcept { return {*this, tag}; }
+
+  private:
+    // when the arena is exhausted, commit more memory (reserved memory) and retry
+    template<typename Allocate>
+    void* grow_and_allocate(std::size_t s, std::size_t alignment, arena_tag tag, Allocate&& allocate) {
+        if (void* ptr = allocate()) return ptr;
+        // requests with an unsupported tag, or which never fit, fail without committing anything
+        if (tag >= num_arena_tags || std::max(s, alignment) > max_size()) return nullptr;
+        return _arena.grow(s, alignment, static_cast<unsigned char*>(this->data()) + this->size(),
+            detail::zero_initialized(*this), [this](void* p, std::size_t n) { return detail::commit(*this, p, n); },
+            allocate);
+    }
+};
+
+// non-owning handle to an arena which tags all its allocations, e.g. to hand a sub-arena for
+// short-lived buffers to a component (also through any_resource); the arena must outlive it
+template<typename Arena>
+class tagged_view {
+    Arena*    _arena;
+    arena_tag _tag;
+
+  public:
+    tagged_view(Arena& a, arena_tag tag) noexcept : _arena{&a}, _tag{tag} {}
+
+    arena_tag tag() const noexcept { return _tag; }
+
+    void* allocate(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        return _arena->allocate(s, alignment, _tag);
+    }
+
+    void* allocate_zeroed(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        return _arena->allocate_zeroed(s, alignment, _tag);
+    }
+
+    allocation_result allocate_at_least(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        return _arena->allocate_at_least(s, alignment, _tag);
     }
 
     void deallocate(void* ptr, std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
-        if (alignment <= alignof(std::max_align_t)) {
-            // arena.deallocate(ptr, s); // deallocate `s` from arena
-        }
-        else {
-            // std::size_t space = s + alignment + sizeof(void*) - 1;
-            // void* orig_ptr = *reinterpret_cast<void**>(reinterpret_cast<unsigned char*>(ptr)+s);
-            // arena.deallocate(orig_ptr, space); // dallocate `space` from arena
-        }
+        _arena->deallocate(ptr, s, alignment);
     }
+
+    std::size_t usable_size(const void* ptr) const noexcept { return _arena->usable_size(ptr); }
+
+    bool try_resize_in_place(void* ptr, std::size_t old_size, std::size_t new_size) {
+        return _arena->try_resize_in_place(ptr, old_size, new_size);
+    }
+
+    auto get_key(void* ptr, std::size_t s) const { return _arena->get_key(ptr, s); }
 };
 
 } // namespace res
 } // namespace hwmalloc2
-
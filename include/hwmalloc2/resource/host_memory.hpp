@@ -11,17 +11,31 @@
 
 #include <cstddef>
 #include <memory>
+#include <new>
+
+#include <sys/mman.h>
 
 namespace hwmalloc2 {
 namespace res {
 
+// anonymous private mapping: page aligned, such that arenas can hand out naturally aligned blocks
+// from the start, and zero initialized
 template<typename Resource>
 struct host_memory : public Resource {
 
-    std::unique_ptr<std::byte[]> _mem;
+    struct deleter {
+        std::size_t _size;
+        void operator()(std::byte* p) const noexcept { ::munmap(p, _size); }
+    };
+
+    std::unique_ptr<std::byte[], deleter> _mem;
     std::size_t _size;
 
-    host_memory(Resource&& r, std::size_t s) : Resource{std::move(r)}, _mem{ new std::byte[s] }, _size{s} {}
+    host_memory(Resource&& r, std::size_t s)
+    : Resource{std::move(r)}
+    , _mem{map(s), deleter{s}}
+    , _size{s}
+    {}
 
     host_memory(host_memory&&) noexcept = default;
 
@@ -31,6 +45,28 @@ struct host_memory : public Resource {
 
     inline operator bool() const noexcept { return (bool)_mem; }
 
+    // fresh mappings read as zero
+    inline bool zero_initialized() const noexcept { return true; }
+
+    // drop the pages backing [ptr, ptr+n), they read as zero when touched again
+    // note: pinned or registered pages must not be decommitted while the NIC may access them, the
+    // pinned and registered layers veto it
+    bool decommit(void* ptr, std::size_t n) noexcept {
+#if defined(__linux__)
+        return ::madvise(ptr, n, MADV_DONTNEED) == 0;
+#else
+        // MADV_DONTNEED does not guarantee zero pages elsewhere
+        return false;
+#endif
+    }
+
+  private:
+    static std::byte* map(std::size_t s) {
+        if (s == 0u) return nullptr;
+        void* ptr = ::mmap(nullptr, s, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) throw std::bad_alloc{};
+        return static_cast<std::byte*>(ptr);
+    }
 };
 
 } // namespace res
@@ -9,6 +9,11 @@
  */
 #pragma once
 
+#include <hwmalloc2/allocation_result.hpp>
+#include <hwmalloc2/detail/clear.hpp>
+#include <hwmalloc2/detail/memory_hooks.hpp>
+
+#include <algorithm>
 #include <cstddef>
 #include <memory>
 
@@ -18,27 +23,60 @@ namespace res {
 template<typename Resource>
 struct not_arena : public Resource {
 
-    not_arena(Resource&& r) : Resource{std::move(r)} {}
+    // whether the memory was never handed out and reads as zero
+    bool _pristine;
+
+    not_arena(Resource&& r) : Resource{std::move(r)}, _pristine{detail::zero_initialized(*this)} {}
 
     not_arena(not_arena&&) noexcept = default;
 
     void* allocate(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        _pristine = false;
+        void* ptr = this->data();
         if (alignment <= alignof(std::max_align_t)) {
-            return (s > this->size()) ? nullptr : this->data();
+            if (s > this->size()) return nullptr;
         }
         else {
-            std::size_t space = s + alignment + sizeof(void*) - 1;
-            if (space > this->size()) return nullptr;
-            std::size_t size = s + sizeof(void*);
-            void* ptr = this->data();
-            void* aligned_ptr = std::align(alignment, size, ptr, space);
-            return aligned_ptr;
+            // align within the memory without reserving room for a header
+            std::size_t space = this->size();
+            if (!std::align(alignment, s, ptr, space)) return nullptr;
         }
+        return detail::commit(*this, ptr, s) ? ptr : nullptr;
+    }
+
+    // allocate zero initialized memory, the first allocation from fresh memory is not cleared
+    void* allocate_zeroed(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        const bool pristine = _pristine;
+        void* ptr = allocate(s, alignment);
+        if (ptr && !pristine) detail::clear(ptr, s);
+        return ptr;
+    }
+
+    // the allocation spans the rest of the committed memory
+    allocation_result allocate_at_least(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        void* ptr = allocate(s, alignment);
+        if (!ptr) return {nullptr, 0u};
+        return {ptr, std::max(s, usable_size(ptr))};
+    }
+
+    // on reserved memory, only the committed part counts (see try_resize_in_place to go beyond)
+    std::size_t usable_size(const void* ptr) const noexcept {
+        if (!ptr) return 0u;
+        const auto offset = static_cast<std::size_t>(static_cast<const unsigned char*>(ptr) - static_cast<const unsigned char*>(this->data()));
+        const auto committed = detail::committed(*this);
+        return committed > offset ? committed - offset : 0u;
     }
 
     void deallocate(void*, std::size_t, std::size_t = alignof(std::max_align_t)) {
         // do nothing
     }
+
+    // the allocation may extend up to the end of the memory
+    bool try_resize_in_place(void* ptr, std::size_t /*old_size*/, std::size_t new_size) {
+        if (!ptr) return false;
+        const auto offset = static_cast<std::size_t>(static_cast<unsigned char*>(ptr) - static_cast<unsigned char*>(this->data()));
+        return new_size <= this->size() - offset && detail::commit(*this, ptr, new_size);
+    }
 };
 
 } // namespace res
@@ -9,6 +9,9 @@
  */
 #pragma once
 
+#include <hwmalloc2/budget.hpp>
+
+#include <cstddef>
 
 namespace hwmalloc2 {
 namespace res {
@@ -16,7 +19,10 @@ namespace res {
 template<typename Resource>
 struct pinned : public Resource {
 
-    pinned(Resource&& r) : Resource{std::move(r)} {
+    detail::locked_bytes _locked;
+
+    // the pinned memory is charged to the budget b, if given (see detail::locked_bytes)
+    pinned(Resource&& r, budget* b = nullptr) : Resource{std::move(r)}, _locked{b, *this} {
         // pin here
     }
 
@@ -28,6 +34,18 @@ struct pinned : public Resource {
         }
     }
 
+    // pinned pages stay resident
+    bool decommit(void*, std::size_t) noexcept
+        requires requires (Resource& r, void* p, std::size_t s) { r.decommit(p, s); }
+    {
+        return false;
+    }
+
+    std::size_t decommit_tail(void*) noexcept
+        requires requires (Resource& r, void* p) { r.decommit_tail(p); }
+    {
+        return 0u;
+    }
 };
 
 } // namespace res
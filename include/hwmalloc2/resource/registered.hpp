@@ -9,21 +9,29 @@
  */
 #pragma once
 
+#include <hwmalloc2/budget.hpp>
 #include <hwmalloc2/concepts.hpp>
 
 namespace hwmalloc2 {
 namespace res {
 
+// registers the memory of the nested resource with a registry
+// decommitting registered pages would let the NIC keep accessing the old physical pages while the
+// cpu faults in new ones: decommit and decommit_tail are only passed on if the region supports on
+// demand paging, i.e. provides on_demand_paging() returning true
 template<typename Resource, Registry R>
 struct registered : public Resource {
 
     using region = std::decay_t<decltype(std::declval<R>().register_memory(nullptr, 0u))>;
     using key = std::decay_t<decltype(std::declval<region>().get_key(nullptr, 0u))>;
 
+    detail::locked_bytes _locked;
     region _region;
 
-    registered(Resource&& r, R& registry)
+    // the registered memory is charged to the budget b, if given (see detail::locked_bytes)
+    registered(Resource&& r, R& registry, budget* b = nullptr)
     : Resource{std::move(r)}
+    , _locked{b, *this}
     , _region{registry.register_memory(this->data(), this->size())}
     {}
 
@@ -33,6 +41,23 @@ struct registered : public Resource {
     //~registered() {}
     
     key get_key(void* ptr, std::size_t s) const { return _region.get_key(ptr, s); }
+
+    bool on_demand_paging() const noexcept {
+        if constexpr (requires { _region.on_demand_paging(); }) return _region.on_demand_paging();
+        else return false;
+    }
+
+    bool decommit(void* ptr, std::size_t n) noexcept
+        requires requires (Resource& r, void* p, std::size_t s) { r.decommit(p, s); }
+    {
+        return on_demand_paging() && Resource::decommit(ptr, n);
+    }
+
+    std::size_t decommit_tail(void* ptr) noexcept
+        requires requires (Resource& r, void* p) { r.decommit_tail(p); }
+    {
+        return on_demand_paging() ? Resource::decommit_tail(ptr) : 0u;
+    }
 };
 
 } // namespace res
@@ -0,0 +1,231 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc2/budget.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include <sys/mman.h>
+
+namespace hwmalloc2 {
+namespace res {
+
+// reserves a contiguous range of address space up front and backs it with memory on demand
+// - data() and size() describe the whole reservation, such that the layers above (registration,
+//   arena) see a single region with a single key
+// - memory is committed (readable, writable and faulted in) in chunks of commit_granularity bytes:
+//   allocators call commit(ptr, n) before handing out [ptr, ptr+n), which commits only the chunks
+//   covering it, and decommit_tail(ptr) to give back everything from ptr on
+// - committed() is the committed prefix of the range, up to which an arena can grow without
+//   further commits; committed_bytes() counts all committed chunks
+// - commits are thread safe, and lock free when the memory is committed already
+// - the memory reads as zero, also after it was decommitted and committed again
+// - committed chunks can be charged to a budget (see charge_commits), commits fail when the
+//   budget is exhausted
+template<typename Resource>
+struct reserved_memory : public Resource {
+
+    static constexpr std::size_t commit_granularity = std::size_t{1} << 21;
+
+    struct deleter {
+        std::size_t _size;
+        void operator()(std::byte* p) const noexcept { ::munmap(p, _size); }
+    };
+
+    // committed chunks (one bit each) and prefix, shared by all users of the memory
+    struct commit_state {
+        std::mutex                                 _mutex;
+        std::atomic<std::size_t>                   _committed{0u};
+        std::atomic<std::size_t>                   _committed_bytes{0u};
+        std::unique_ptr<std::atomic<std::uint64_t>[]> _chunks;
+        budget*                                    _budget = nullptr;
+
+        commit_state(std::size_t num_chunks) : _chunks{new std::atomic<std::uint64_t>[(num_chunks + 63) / 64]} {
+            for (std::size_t i = 0; i < (num_chunks + 63) / 64; ++i) _chunks[i].store(0u, std::memory_order_relaxed);
+        }
+
+        ~commit_state() {
+            if (_budget) _budget->release(_committed_bytes.load(std::memory_order_relaxed));
+        }
+
+        bool is_committed(std::size_t c) const noexcept {
+            return (_chunks[c / 64].load(std::memory_order_acquire) >> (c % 64)) & 1u;
+        }
+
+        void set(std::size_t c, bool committed) noexcept {
+            const auto bit = std::uint64_t{1} << (c % 64);
+            if (committed) _chunks[c / 64].fetch_or(bit, std::memory_order_release);
+            else _chunks[c / 64].fetch_and(~bit, std::memory_order_release);
+        }
+    };
+
+    std::unique_ptr<std::byte[], deleter> _mem;
+    std::size_t _size;
+    std::unique_ptr<commit_state> _state;
+
+    reserved_memory(Resource&& r, std::size_t s, std::size_t initial_commit = 0u)
+    : Resource{std::move(r)}
+    , _mem{reserve(s), deleter{s}}
+    , _size{s}
+    , _state{std::make_unique<commit_state>(num_chunks())}
+    {
+        if (initial_commit && !commit(_mem.get(), initial_commit)) throw std::bad_alloc{};
+    }
+
+    reserved_memory(reserved_memory&&) noexcept = default;
+
+    inline void* data() const noexcept { return _mem.get(); }
+
+    inline auto size() const noexcept { return _size; }
+
+    inline operator bool() const noexcept { return (bool)_mem; }
+
+    inline bool zero_initialized() const noexcept { return true; }
+
+    // number of committed bytes at the start of the range
+    std::size_t committed() const noexcept { return _state->_committed.load(std::memory_order_acquire); }
+
+    // number of committed bytes in the whole range
+    std::size_t committed_bytes() const noexcept { return _state->_committed_bytes.load(std::memory_order_relaxed); }
+
+    // make sure [ptr, ptr+n) is committed, returns false if the memory could not be committed
+    bool commit(void* ptr, std::size_t n) noexcept {
+        const auto offset = static_cast<std::size_t>(static_cast<std::byte*>(ptr) - _mem.get());
+        if (offset > _size || n > _size - offset) return false;
+        const auto end = offset + n;
+        if (end <= committed()) return true;
+        const auto first = offset / commit_granularity;
+        const auto last = (end + commit_granularity - 1) / commit_granularity;
+        if (all_committed(first, last)) return true;
+        std::lock_guard<std::mutex> lock{_state->_mutex};
+        // charge the missing chunks up front (the limit is a hard cap, the policy is not applied)
+        std::size_t missing = 0u;
+        for (auto c = first; c < last; ++c)
+            if (!_state->is_committed(c)) missing += chunk_size(c);
+        if (_state->_budget && !_state->_budget->try_charge(missing)) return false;
+        // commit the missing chunks in runs
+        for (auto c = first; c < last;) {
+            if (_state->is_committed(c)) {
+                ++c;
+                continue;
+            }
+            auto d = c + 1;
+            while (d < last && !_state->is_committed(d)) ++d;
+            std::byte* p = _mem.get() + c * commit_granularity;
+            const auto bytes = std::min(_size, d * commit_granularity) - c * commit_granularity;
+            if (::mprotect(p, bytes, PROT_READ | PROT_WRITE) != 0) {
+                if (_state->_budget) _state->_budget->release(missing);
+                extend_prefix();
+                return false;
+            }
+            populate(p, bytes);
+            for (auto i = c; i < d; ++i) _state->set(i, true);
+            _state->_committed_bytes.fetch_add(bytes, std::memory_order_relaxed);
+            missing -= bytes;
+            c = d;
+        }
+        extend_prefix();
+        return true;
+    }
+
+    // decommit everything from ptr (rounded up to the commit granularity) to the end of the range
+    // returns the number of decommitted bytes
+    std::size_t decommit_tail(void* ptr) noexcept {
+        std::lock_guard<std::mutex> lock{_state->_mutex};
+        const auto offset = static_cast<std::size_t>(static_cast<std::byte*>(ptr) - _mem.get());
+        const auto first = (offset + commit_granularity - 1) / commit_granularity;
+        std::size_t bytes = 0u;
+        for (auto c = first; c < num_chunks(); ++c) {
+            if (!_state->is_committed(c)) continue;
+            // replace the pages by a fresh reservation, which releases them and makes them read
+            // as zero
+            std::byte* p = _mem.get() + c * commit_granularity;
+            const auto n = chunk_size(c);
+            if (::mmap(p, n, PROT_NONE, map_flags | MAP_FIXED, -1, 0) == MAP_FAILED) break;
+            _state->set(c, false);
+            bytes += n;
+        }
+        _state->_committed_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        if (_state->_budget) _state->_budget->release(bytes);
+        if (committed() > first * commit_granularity)
+            _state->_committed.store(first * commit_granularity, std::memory_order_release);
+        return bytes;
+    }
+
+    // charge the committed chunks to b from now on, on behalf of a pinned or registered layer (see
+    // detail::locked_bytes); throws std::bad_alloc if the memory committed so far exceeds the limit
+    void charge_commits(budget& b) {
+        std::lock_guard<std::mutex> lock{_state->_mutex};
+        if (_state->_budget) return;
+        if (!b.charge(committed_bytes())) throw std::bad_alloc{};
+        _state->_budget = &b;
+    }
+
+    // drop the pages backing [ptr, ptr+n), they stay committed and read as zero when touched again
+    bool decommit(void* ptr, std::size_t n) noexcept {
+#if defined(__linux__)
+        return ::madvise(ptr, n, MADV_DONTNEED) == 0;
+#else
+        return false;
+#endif
+    }
+
+  private:
+#if defined(MAP_NORESERVE)
+    static constexpr int map_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#else
+    static constexpr int map_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#endif
+
+    std::size_t num_chunks() const noexcept { return (_size + commit_granularity - 1) / commit_granularity; }
+
+    std::size_t chunk_size(std::size_t c) const noexcept {
+        return std::min(_size, (c + 1) * commit_granularity) - c * commit_granularity;
+    }
+
+    bool all_committed(std::size_t first, std::size_t last) const noexcept {
+        for (auto c = first; c < last; ++c)
+            if (!_state->is_committed(c)) return false;
+        return true;
+    }
+
+    // extend the committed prefix over the chunks committed since (requires the lock)
+    void extend_prefix() noexcept {
+        auto c = committed() / commit_granularity;
+        while (c < num_chunks() && _state->is_committed(c)) ++c;
+        _state->_committed.store(std::min(_size, c * commit_granularity), std::memory_order_release);
+    }
+
+    static std::byte* reserve(std::size_t s) {
+        if (s == 0u) return nullptr;
+        void* ptr = ::mmap(nullptr, s, PROT_NONE, map_flags, -1, 0);
+        if (ptr == MAP_FAILED) throw std::bad_alloc{};
+        return static_cast<std::byte*>(ptr);
+    }
+
+    // fault the pages in, such that they are backed when they are pinned or registered
+    static void populate(std::byte* p, std::size_t n) noexcept {
+#if defined(MADV_POPULATE_WRITE)
+        if (::madvise(p, n, MADV_POPULATE_WRITE) == 0) return;
+#endif
+        // fresh pages read as zero, writing a zero faults them in without changing them
+        for (std::size_t i = 0; i < n; i += 4096u) reinterpret_cast<volatile std::byte*>(p)[i] = std::byte{0};
+    }
+};
+
+} // namespace res
+} // namespace hwmalloc2
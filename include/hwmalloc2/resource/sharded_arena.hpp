@@ -0,0 +1,203 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc2/allocation_result.hpp>
+#include <hwmalloc2/arena_config.hpp>
+#include <hwmalloc2/detail/arena_impl.hpp>
+#include <hwmalloc2/detail/clear.hpp>
+#include <hwmalloc2/detail/memory_hooks.hpp>
+#include <hwmalloc2/detail/cpu.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace hwmalloc2 {
+namespace res {
+
+// thread safe arena which splits the memory of the nested resource into one shard per cpu and a
+// shared heap
+// - allocations are served by the shard of the cpu the calling thread runs on, and fall back to
+//   the other shards and then to the shared heap when it is exhausted
+// - requests larger than a shard are served by the shared heap directly
+// - deallocations go to the shard owning the address, from whichever thread
+// - every shard is protected by its own lock, which is rarely contended as long as threads do not
+//   migrate within the critical section
+// with more than one shard, the shards get half of the memory and the shared heap the other half
+// memory overhead is thus proportional to the number of cores rather than the number of threads
+// on reserved memory, the chunks under a block are committed before it is handed out, such that
+// every shard and the shared heap commit only the memory they use (see reserved_memory::commit);
+// the page tables of the shards start out with the committed memory and grow with their use too
+template<typename Resource>
+struct sharded_arena : public Resource {
+
+    struct alignas(64) shard {
+        detail::spin_mutex _mutex;
+        detail::arena_impl _arena;
+    };
+
+    // the shards followed by the shared heap
+    std::unique_ptr<shard[]> _shards;
+    std::size_t _num_shards = 0u;
+    std::size_t _shard_size = 0u;
+    unsigned char* _base = nullptr;
+
+    // num_shards == 0 selects one shard per online cpu
+    sharded_arena(Resource&& r, std::size_t num_shards = 0u, const arena_config& config = {})
+    : Resource{std::move(r)}
+    {
+        if (num_shards == 0u) num_shards = detail::num_cpus();
+        // shards consist of whole pages
+        const auto num_pages = this->size() / detail::page_size;
+        num_shards = std::max<std::size_t>(1u, std::min(num_shards, num_pages / 2));
+        const auto shard_pages = num_shards == 1u ? num_pages : num_pages / 2 / num_shards;
+        _shard_size = std::max<std::size_t>(1u, shard_pages) * detail::page_size;
+        _num_shards = num_shards;
+        _base = static_cast<unsigned char*>(this->data());
+        const bool zeroed = detail::zero_initialized(*this);
+        _shards.reset(new shard[_num_shards + 1]);
+        const auto committed = detail::committed(*this);
+        for (std::size_t i = 0; i <= _num_shards; ++i) {
+            const auto [begin, size] = range(i);
+            const auto offset = static_cast<std::size_t>(begin - _base);
+            _shards[i]._arena = detail::arena_impl{begin, committed > offset ? std::min(size, committed - offset) : 0u,
+                config, zeroed};
+        }
+    }
+
+    sharded_arena(sharded_arena&&) noexcept = default;
+
+    std::size_t num_shards() const noexcept { return _num_shards; }
+
+    // largest request which can be served once all memory is free (also memory yet to be committed)
+    std::size_t max_size() const noexcept {
+        std::size_t n = 0u;
+        for (std::size_t i = 0; i <= _num_shards; ++i) {
+            const auto [begin, size] = range(i);
+            n = std::max(n, detail::arena_impl::max_block_size(begin, size));
+        }
+        return n;
+    }
+
+    void* allocate(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        return allocate_at_least(s, alignment).ptr;
+    }
+
+    // allocate and report the usable size of the block
+    allocation_result allocate_at_least(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        allocation_result r{nullptr, 0u};
+        try_heaps(s, alignment, [&](std::size_t i) {
+            auto& sh = _shards[i];
+            std::lock_guard<detail::spin_mutex> lock{sh._mutex};
+            if (void* ptr = grow_and_allocate(i, s, alignment, [&] { return sh._arena.allocate(s, alignment); })) {
+                const auto n = sh._arena.usable_size(ptr);
+                if (detail::commit(*this, ptr, n)) r = {ptr, n};
+                else sh._arena.deallocate(ptr, s, alignment);
+            }
+            return r.ptr != nullptr;
+        });
+        return r;
+    }
+
+    // allocate zero initialized memory: the clear is skipped for pristine blocks, and done outside
+    // of the lock otherwise
+    void* allocate_zeroed(std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        void* ptr = nullptr;
+        bool pristine = false;
+        try_heaps(s, alignment, [&](std::size_t i) {
+            auto& sh = _shards[i];
+            std::lock_guard<detail::spin_mutex> lock{sh._mutex};
+            ptr = grow_and_allocate(i, s, alignment, [&] { return sh._arena.allocate_pristine(s, alignment, pristine); });
+            if (ptr && !detail::commit(*this, ptr, sh._arena.usable_size(ptr))) {
+                sh._arena.deallocate(ptr, s, alignment);
+                ptr = nullptr;
+            }
+            return ptr != nullptr;
+        });
+        if (ptr && !pristine) detail::clear(ptr, s);
+        return ptr;
+    }
+
+    // decommit free memory of all shards, if supported by the memory resource
+    std::size_t trim() {
+        std::size_t bytes = 0u;
+        for (std::size_t i = 0; i <= _num_shards; ++i) {
+            std::lock_guard<detail::spin_mutex> lock{_shards[i]._mutex};
+            bytes += _shards[i]._arena.trim([this](void* p, std::size_t n) { return detail::decommit(*this, p, n); });
+        }
+        return bytes;
+    }
+
+    std::size_t usable_size(const void* ptr) const noexcept {
+        if (!ptr) return 0u;
+        auto& sh = _shards[shard_index(ptr)];
+        std::lock_guard<detail::spin_mutex> lock{sh._mutex};
+        return sh._arena.usable_size(ptr);
+    }
+
+    void deallocate(void* ptr, std::size_t s, std::size_t alignment = alignof(std::max_align_t)) {
+        if (!ptr) return;
+        auto& sh = _shards[shard_index(ptr)];
+        std::lock_guard<detail::spin_mutex> lock{sh._mutex};
+        sh._arena.deallocate(ptr, s, alignment);
+    }
+
+    // grow or shrink an allocation without moving it (the key stays valid)
+    bool try_resize_in_place(void* ptr, std::size_t old_size, std::size_t new_size) {
+        if (!ptr) return false;
+        auto& sh = _shards[shard_index(ptr)];
+        std::lock_guard<detail::spin_mutex> lock{sh._mutex};
+        if (!sh._arena.try_resize(ptr, new_size)) return false;
+        if (detail::commit(*this, ptr, sh._arena.usable_size(ptr))) return true;
+        sh._arena.try_resize(ptr, old_size);
+        return false;
+    }
+
+  private:
+    // the shard or the shared heap (index num_shards()) owning ptr
+    std::size_t shard_index(const void* ptr) const noexcept {
+        const auto i = static_cast<std::size_t>(static_cast<const unsigned char*>(ptr) - _base) / _shard_size;
+        return std::min(i, _num_shards);
+    }
+
+    // part of the memory of shard i, the shared heap takes the remainder
+    std::pair<unsigned char*, std::size_t> range(std::size_t i) const noexcept {
+        const auto offset = std::min(i * _shard_size, this->size());
+        return {_base + offset, i == _num_shards ? this->size() - offset : _shard_size};
+    }
+
+    // when shard i (locked) is exhausted, add more of its part to its page heap and retry; the
+    // memory is committed per block
+    template<typename Allocate>
+    void* grow_and_allocate(std::size_t i, std::size_t s, std::size_t alignment, Allocate&& allocate) {
+        if (void* ptr = allocate()) return ptr;
+        const auto [begin, size] = range(i);
+        return _shards[i]._arena.grow(s, alignment, begin + size, detail::zero_initialized(*this),
+            [](void*, std::size_t) { return true; }, allocate);
+    }
+
+    // call f on the index of the shard of the current cpu, the other shards and the shared heap,
+    // until it returns true; requests larger than a shard skip the shards
+    template<typename F>
+    void try_heaps(std::size_t s, std::size_t alignment, F&& f) {
+        if (std::max(s, alignment) <= _shard_size) {
+            const auto first = detail::current_cpu() % _num_shards;
+            for (std::size_t j = 0; j < _num_shards; ++j)
+                if (f((first + j) % _num_shards)) return;
+        }
+        f(_num_shards);
+    }
+};
+
+} // namespace res
+} // namespace hwmalloc2
@@ -11,17 +11,22 @@
 
 #include <hwmalloc2/config.hpp>
 #include <hwmalloc2/concepts.hpp>
+#include <hwmalloc2/arena_config.hpp>
 #include <hwmalloc2/resource/sentinel.hpp>
 #include <hwmalloc2/resource/not_memory.hpp>
 #include <hwmalloc2/resource/host_memory.hpp>
 #include <hwmalloc2/resource/user_host_memory.hpp>
+#include <hwmalloc2/resource/reserved_memory.hpp>
 #include <hwmalloc2/resource/pinned.hpp>
 #include <hwmalloc2/resource/not_pinned.hpp>
 #include <hwmalloc2/resource/registered.hpp>
 #include <hwmalloc2/resource/not_registered.hpp>
 #include <hwmalloc2/resource/arena.hpp>
+#include <hwmalloc2/resource/sharded_arena.hpp>
 #include <hwmalloc2/resource/not_arena.hpp>
 #include <hwmalloc2/any_resource.hpp>
+#include <hwmalloc2/async_resource.hpp>
+#include <hwmalloc2/budget.hpp>
 
 #include <tuple>
 
@@ -187,22 +192,52 @@ struct _resource_builder {
         return updated<0, res::arena>(std::tuple<>{});
     }
 
+    constexpr auto add_arena(const arena_config& config) const {
+        // arena resources are stored at position 0 in the resource nest
+        return updated<0, res::arena>(std::make_tuple(config));
+    }
+
+    constexpr auto add_sharded_arena(std::size_t num_shards = 0u, const arena_config& config = {}) const {
+        // arena resources are stored at position 0 in the resource nest
+        return updated<0, res::sharded_arena>(std::make_tuple(num_shards, config));
+    }
+
     template<Registry R>
     constexpr auto register_memory(R& registry) const {
         // registered resources are stored at position 1 in the resource nest
         return updated<1, res::registered, R>(std::tuple<R&>{registry});
     }
 
+    // charge the registered memory to a budget, e.g. budget::process()
+    // (a stack which is pinned and registered should charge only one of the two)
+    template<Registry R>
+    constexpr auto register_memory(R& registry, budget& b) const {
+        // registered resources are stored at position 1 in the resource nest
+        return updated<1, res::registered, R>(std::tuple<R&, budget*>{registry, &b});
+    }
+
     constexpr auto pin() const {
         // pinned resources are stored at position 2 in the resource nest
         return updated<2, res::pinned>(std::tuple<>{});
     }
 
+    // charge the pinned memory to a budget, e.g. budget::process()
+    constexpr auto pin(budget& b) const {
+        // pinned resources are stored at position 2 in the resource nest
+        return updated<2, res::pinned>(std::tuple<budget*>{&b});
+    }
+
     constexpr auto alloc_on_host(std::size_t s) const {
         // memory resources are stored at position 3 in the resource nest
         return updated<3, res::host_memory>(std::make_tuple(s));
     }
 
+    // reserve s bytes of address space and commit memory as it is used
+    constexpr auto reserve_memory(std::size_t s, std::size_t initial_commit = 0u) const {
+        // memory resources are stored at position 3 in the resource nest
+        return updated<3, res::reserved_memory>(std::make_tuple(s, initial_commit));
+    }
+
     constexpr auto use_host_memory(void* p, std::size_t s) const {
         // memory resources are stored at position 3 in the resource nest
         return updated<3, res::user_host_memory>(std::make_tuple(p, s));
@@ -212,6 +247,12 @@ struct _resource_builder {
 
     constexpr auto build_any() const { return any_resource{build()}; }
 
+    // charge all allocations to a budget
+    auto build_budgeted(budget& b) const { return budgeted_resource{build(), b}; }
+
+    // allocations can wait for memory (the resource is not movable)
+    auto build_async() const { return async_resource{build()}; }
+
   private:
     const args_t args;
 
@@ -0,0 +1,226 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HWMALLOC2_HAVE_X86_COPY_KERNELS 1
+#endif
+
+namespace hwmalloc2 {
+
+// instruction set used by the copy kernels
+enum class copy_isa { scalar, avx2, avx512 };
+
+// layout of strided data: `count` blocks of `block_size` bytes, `stride` bytes apart
+struct strided_layout {
+    std::size_t count;
+    std::size_t block_size;
+    std::size_t stride;
+
+    std::size_t packed_size() const noexcept { return count * block_size; }
+};
+
+namespace detail {
+
+// copy kernels: copy n bytes, using non-temporal stores if `nt` is set
+// non-temporal stores bypass the cache, which pays off when the destination is not read again soon
+// (e.g. by the cpu before the NIC reads it) and the data does not fit into the cache anyway
+
+inline void copy_scalar(unsigned char* d, const unsigned char* s, std::size_t n, bool) noexcept {
+    std::memcpy(d, s, n);
+}
+
+#if defined(HWMALLOC2_HAVE_X86_COPY_KERNELS)
+__attribute__((target("avx2"))) inline void copy_avx2(unsigned char* d, const unsigned char* s, std::size_t n, bool nt) noexcept {
+    if (!nt || n < 256) {
+        std::memcpy(d, s, n);
+        return;
+    }
+    // align the destination for the streaming stores
+    const std::size_t head = (32u - (reinterpret_cast<std::uintptr_t>(d) & 31u)) & 31u;
+    std::memcpy(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+    for (; n >= 128; n -= 128, d += 128, s += 128) {
+        const auto v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+        const auto v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 32));
+        const auto v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 64));
+        const auto v3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 96));
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d), v0);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 32), v1);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 64), v2);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 96), v3);
+    }
+    for (; n >= 32; n -= 32, d += 32, s += 32)
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(d), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s)));
+    std::memcpy(d, s, n);
+}
+
+__attribute__((target("avx512f"))) inline void copy_avx512(unsigned char* d, const unsigned char* s, std::size_t n, bool nt) noexcept {
+    if (!nt || n < 512) {
+        std::memcpy(d, s, n);
+        return;
+    }
+    const std::size_t head = (64u - (reinterpret_cast<std::uintptr_t>(d) & 63u)) & 63u;
+    std::memcpy(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+    for (; n >= 256; n -= 256, d += 256, s += 256) {
+        const auto v0 = _mm512_loadu_si512(s);
+        const auto v1 = _mm512_loadu_si512(s + 64);
+        const auto v2 = _mm512_loadu_si512(s + 128);
+        const auto v3 = _mm512_loadu_si512(s + 192);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d), v0);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 64), v1);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 128), v2);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 192), v3);
+    }
+    for (; n >= 64; n -= 64, d += 64, s += 64)
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(d), _mm512_loadu_si512(s));
+    std::memcpy(d, s, n);
+}
+#endif
+
+using copy_kernel = void (*)(unsigned char*, const unsigned char*, std::size_t, bool) noexcept;
+
+// gather/scatter of small fixed size blocks: the block copy is inlined
+template<std::size_t B, bool Pack>
+inline void copy_blocks_fixed(unsigned char* d, const unsigned char* s, std::size_t count, std::size_t stride) noexcept {
+    for (std::size_t i = 0; i < count; ++i) {
+        if constexpr (Pack) std::memcpy(d + i * B, s + i * stride, B);
+        else std::memcpy(d + i * stride, s + i * B, B);
+    }
+}
+
+template<bool Pack>
+inline void copy_blocks(copy_kernel k, unsigned char* d, const unsigned char* s, const strided_layout& l, bool nt) noexcept {
+    switch (l.block_size) {
+        case 4: return copy_blocks_fixed<4, Pack>(d, s, l.count, l.stride);
+        case 8: return copy_blocks_fixed<8, Pack>(d, s, l.count, l.stride);
+        case 16: return copy_blocks_fixed<16, Pack>(d, s, l.count, l.stride);
+        case 32: return copy_blocks_fixed<32, Pack>(d, s, l.count, l.stride);
+        default: break;
+    }
+    for (std::size_t i = 0; i < l.count; ++i) {
+        if constexpr (Pack) k(d + i * l.block_size, s + i * l.stride, l.block_size, nt);
+        else k(d + i * l.stride, s + i * l.block_size, l.block_size, nt);
+    }
+}
+
+} // namespace detail
+
+// best instruction set supported by the cpu
+inline copy_isa best_copy_isa() noexcept {
+#if defined(HWMALLOC2_HAVE_X86_COPY_KERNELS)
+    if (__builtin_cpu_supports("avx512f")) return copy_isa::avx512;
+    if (__builtin_cpu_supports("avx2")) return copy_isa::avx2;
+#endif
+    return copy_isa::scalar;
+}
+
+// copy engine for staging data into (and out of) registered buffers
+// - contiguous copies and strided pack/unpack
+// - kernels are chosen at runtime from the instruction sets supported by the cpu, with a scalar
+//   (memcpy based) fallback; requesting an unsupported instruction set selects the fallback
+// - copies of at least `nt_threshold` bytes use non-temporal stores
+class copy_engine {
+    detail::copy_kernel _kernel = &detail::copy_scalar;
+    copy_isa            _isa = copy_isa::scalar;
+    std::size_t         _nt_threshold;
+
+  public:
+    static constexpr std::size_t default_nt_threshold = std::size_t{1} << 22;
+
+    copy_engine(copy_isa isa = best_copy_isa(), std::size_t nt_threshold = default_nt_threshold) noexcept
+    : _nt_threshold{nt_threshold}
+    {
+#if defined(HWMALLOC2_HAVE_X86_COPY_KERNELS)
+        if (isa == copy_isa::avx512 && __builtin_cpu_supports("avx512f")) {
+            _kernel = &detail::copy_avx512;
+            _isa = isa;
+        }
+        else if (isa != copy_isa::scalar && __builtin_cpu_supports("avx2")) {
+            _kernel = &detail::copy_avx2;
+            _isa = copy_isa::avx2;
+        }
+#endif
+    }
+
+    copy_isa isa() const noexcept { return _isa; }
+
+    std::size_t nt_threshold() const noexcept { return _nt_threshold; }
+
+    void copy(void* dst, const void* src, std::size_t n) const noexcept {
+        const bool nt = n >= _nt_threshold;
+        _kernel(static_cast<unsigned char*>(dst), static_cast<const unsigned char*>(src), n, nt);
+        if (nt) fence();
+    }
+
+    // gather strided blocks from src into contiguous dst
+    void pack(void* dst, const void* src, const strided_layout& l) const noexcept {
+        const bool nt = l.packed_size() >= _nt_threshold;
+        detail::copy_blocks<true>(_kernel, static_cast<unsigned char*>(dst), static_cast<const unsigned char*>(src), l, nt);
+        if (nt) fence();
+    }
+
+    // scatter contiguous src into strided blocks in dst
+    void unpack(void* dst, const void* src, const strided_layout& l) const noexcept {
+        const bool nt = l.packed_size() >= _nt_threshold;
+        detail::copy_blocks<false>(_kernel, static_cast<unsigned char*>(dst), static_cast<const unsigned char*>(src), l, nt);
+        if (nt) fence();
+    }
+
+  private:
+    // make non-temporal stores visible before the buffer is handed to the NIC
+    void fence() const noexcept {
+#if defined(HWMALLOC2_HAVE_X86_COPY_KERNELS)
+        if (_isa != copy_isa::scalar) _mm_sfence();
+#endif
+    }
+};
+
+// contiguous buffer allocated from a resource, together with its key
+template<typename Key>
+struct staged_buffer {
+    void*       ptr;
+    std::size_t size;
+    Key         key;
+};
+
+// allocate a buffer from `r`, pack strided data from `src` into it and obtain the buffer's key
+// returns an empty optional if the resource is exhausted
+template<typename Resource>
+auto stage(Resource& r, const void* src, const strided_layout& l, const copy_engine& e = {})
+    -> std::optional<staged_buffer<std::decay_t<decltype(r.get_key(nullptr, 0u))>>> {
+    const auto size = l.packed_size();
+    void* ptr = r.allocate(size);
+    if (!ptr) return std::nullopt;
+    e.pack(ptr, src, l);
+    return staged_buffer<std::decay_t<decltype(r.get_key(nullptr, 0u))>>{ptr, size, r.get_key(ptr, size)};
+}
+
+// unpack a staged buffer into strided data at `dst` and return the buffer to `r`
+template<typename Resource, typename Key>
+void unstage(Resource& r, const staged_buffer<Key>& b, void* dst, const strided_layout& l, const copy_engine& e = {}) {
+    e.unpack(dst, b.ptr, l);
+    r.deallocate(b.ptr, b.size);
+}
+
+} // namespace hwmalloc2
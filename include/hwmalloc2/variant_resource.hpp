@@ -0,0 +1,110 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc2/allocation_result.hpp>
+#include <hwmalloc2/detail/clear.hpp>
+#include <hwmalloc2/resource_builder.hpp>
+
+#include <any>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace hwmalloc2 {
+
+// type-erases a resource from a closed set of resource types Rs...
+// the resource is stored inline and calls are dispatched by switching on the type index, such that
+// they can be inlined; the interface is the same as the one of any_resource (keys are wrapped in a
+// std::any object), visit gives access to the concrete resource and its key type
+template<typename... Rs>
+class variant_resource {
+    static_assert(sizeof...(Rs) > 0);
+
+    std::variant<Rs...> _r;
+
+  public:
+    template<typename R>
+        requires (std::is_same_v<std::decay_t<R>, Rs> || ...)
+    variant_resource(R&& r) : _r{std::forward<R>(r)} {}
+
+    template<typename Resource, typename Args>
+    variant_resource(const _resource_builder<Resource, Args>& b) : _r{b.build()} {}
+
+    variant_resource(variant_resource&&) noexcept = default;
+    variant_resource& operator=(variant_resource&&) noexcept = default;
+
+    std::size_t index() const noexcept { return _r.index(); }
+
+    // invoke f with the concrete resource
+    template<typename F>
+    decltype(auto) visit(F&& f) { return dispatch<0>(std::forward<F>(f)); }
+
+    void* allocate(std::size_t s, std::size_t a = alignof(std::max_align_t)) {
+        return visit([&](auto& r) { return r.allocate(s, a); });
+    }
+
+    void* allocate_zeroed(std::size_t s, std::size_t a = alignof(std::max_align_t)) {
+        return visit([&](auto& r) {
+            if constexpr (requires { r.allocate_zeroed(s, a); }) return r.allocate_zeroed(s, a);
+            else {
+                void* p = r.allocate(s, a);
+                if (p) detail::clear(p, s);
+                return p;
+            }
+        });
+    }
+
+    allocation_result allocate_at_least(std::size_t s, std::size_t a = alignof(std::max_align_t)) {
+        return visit([&](auto& r) -> allocation_result {
+            if constexpr (requires { r.allocate_at_least(s, a); }) return r.allocate_at_least(s, a);
+            else {
+                void* p = r.allocate(s, a);
+                return {p, p ? s : 0u};
+            }
+        });
+    }
+
+    // usable size of an allocation, 0 if unknown
+    std::size_t usable_size(const void* p) {
+        return visit([&](auto& r) -> std::size_t {
+            if constexpr (requires { r.usable_size(p); }) return r.usable_size(p);
+            else return 0u;
+        });
+    }
+
+    void deallocate(void* p, std::size_t s, std::size_t a = alignof(std::max_align_t)) {
+        visit([&](auto& r) { r.deallocate(p, s, a); });
+    }
+
+    bool try_resize_in_place(void* p, std::size_t s, std::size_t n) {
+        return visit([&](auto& r) {
+            if constexpr (requires { r.try_resize_in_place(p, s, n); }) return r.try_resize_in_place(p, s, n);
+            else return false;
+        });
+    }
+
+    std::any get_key(void* p, std::size_t s) {
+        return visit([&](auto& r) { return std::any{r.get_key(p, s)}; });
+    }
+
+  private:
+    template<std::size_t I, typename F>
+    decltype(auto) dispatch(F&& f) {
+        if constexpr (I + 1 == sizeof...(Rs)) return std::forward<F>(f)(*std::get_if<I>(&_r));
+        else {
+            if (_r.index() == I) return std::forward<F>(f)(*std::get_if<I>(&_r));
+            return dispatch<I + 1>(std::forward<F>(f));
+        }
+    }
+};
+
+} // namespace hwmalloc2
@@ -0,0 +1,588 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <hwmalloc2/any_resource.hpp>
+#include <hwmalloc2/resource_builder.hpp>
+#include <hwmalloc2/mock_registry.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+bool is_aligned(void* ptr, std::size_t alignment) {
+    return reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0;
+}
+
+} // namespace
+
+TEST_CASE( "natural alignment", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    auto m = resource_builder().alloc_on_host(1u << 23).add_arena().build();
+
+    for (std::size_t s : {16u, 48u, 100u, 1000u, 2048u}) {
+        void* ptr = m.allocate(s);
+        REQUIRE(ptr != nullptr);
+        CHECK(is_aligned(ptr, alignof(std::max_align_t)));
+        m.deallocate(ptr, s);
+    }
+
+    // over-aligned small blocks come from a larger class
+    void* p0 = m.allocate(24, 256);
+    CHECK(is_aligned(p0, 256));
+
+    // page and huge page aligned requests are exact
+    void* p1 = m.allocate(4096, 4096);
+    CHECK(is_aligned(p1, 4096));
+    void* p2 = m.allocate(1u << 21, 1u << 21);
+    REQUIRE(p2 != nullptr);
+    CHECK(is_aligned(p2, 1u << 21));
+
+    m.deallocate(p2, 1u << 21, 1u << 21);
+    m.deallocate(p1, 4096, 4096);
+    m.deallocate(p0, 24, 256);
+}
+
+TEST_CASE( "reuse and coalescing", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    constexpr std::size_t size = 1u << 20;
+    constexpr std::size_t block = 1u << 16;
+    auto m = resource_builder().alloc_on_host(size).add_arena().build();
+
+    auto count_blocks = [&m]() {
+        std::vector<void*> blocks;
+        while (void* ptr = m.allocate(block)) blocks.push_back(ptr);
+        for (auto p : blocks) m.deallocate(p, block);
+        return blocks.size();
+    };
+
+    const auto n = count_blocks();
+    // the region is only page aligned: the first and last partial blocks may not combine
+    CHECK(n >= size / block - 1);
+
+    // fill with small and page sized blocks
+    std::vector<void*> small;
+    std::vector<void*> pages;
+    for (int i = 0; i < 64; ++i) {
+        small.push_back(m.allocate(64));
+        pages.push_back(m.allocate(4096));
+        REQUIRE(small.back() != nullptr);
+        REQUIRE(pages.back() != nullptr);
+    }
+    for (auto p : small) m.deallocate(p, 64);
+    for (auto p : pages) m.deallocate(p, 4096);
+
+    // all blocks coalesced again, apart from the one cached slab
+    CHECK(count_blocks() >= n - 1);
+}
+
+TEST_CASE( "not_arena alignment", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    std::vector<char> v(8192);
+    auto m = resource_builder().use_host_memory(v.data(), v.size()).build();
+
+    void* ptr = m.allocate(4096, 4096);
+    REQUIRE(ptr != nullptr);
+    CHECK(is_aligned(ptr, 4096));
+
+    // over-aligned requests do not reserve room for a header: page aligned memory fits exactly
+    struct alignas(4096) page_buffer {
+        unsigned char data[8192];
+    };
+    auto buffer = std::make_unique<page_buffer>();
+    auto a = resource_builder().use_host_memory(buffer->data, sizeof(buffer->data)).build();
+    void* p0 = a.allocate(8192, 4096);
+    REQUIRE(p0 != nullptr);
+    CHECK(p0 == buffer->data);
+}
+
+TEST_CASE( "sharded arena", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    constexpr std::size_t num_threads = 8;
+    auto m = resource_builder().alloc_on_host(1u << 22).add_sharded_arena(4).build();
+    CHECK(m.num_shards() == 4);
+
+    // blocks are allocated and released on different threads
+    std::vector<std::vector<void*>> blocks(num_threads);
+    auto run = [&](auto f) {
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < num_threads; ++t) threads.emplace_back(f, t);
+        for (auto& t : threads) t.join();
+    };
+    run([&](std::size_t t) {
+        for (int i = 0; i < 200; ++i) {
+            const std::size_t s = (i % 3 == 0) ? 4096 : 48;
+            void* ptr = m.allocate(s);
+            if (ptr) std::memset(ptr, static_cast<int>(t), s);
+            blocks[t].push_back(ptr);
+        }
+    });
+    for (auto& b : blocks)
+        for (auto p : b) REQUIRE(p != nullptr);
+    run([&](std::size_t t) {
+        auto& b = blocks[(t + 1) % num_threads];
+        for (std::size_t i = 0; i < b.size(); ++i) m.deallocate(b[i], (i % 3 == 0) ? 4096 : 48);
+    });
+
+    // allocations spill over to other shards when the local one is exhausted
+    std::vector<void*> big;
+    while (void* ptr = m.allocate(1u << 18)) big.push_back(ptr);
+    CHECK(big.size() >= 8);
+    for (auto p : big) m.deallocate(p, 1u << 18);
+}
+
+TEST_CASE( "sharded arena large blocks", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    auto m = resource_builder().alloc_on_host(1u << 22).add_sharded_arena(64).build();
+    CHECK(m.num_shards() == 64);
+    CHECK(m.max_size() >= (1u << 20));
+    CHECK(m.max_size() <= (1u << 21));
+
+    // requests larger than a shard are served by the shared heap
+    for (std::size_t s : {std::size_t{1} << 17, std::size_t{1} << 20}) {
+        void* ptr = m.allocate(s);
+        REQUIRE(ptr != nullptr);
+        CHECK(m.usable_size(ptr) == s);
+        std::memset(ptr, 1, s);
+        m.deallocate(ptr, s);
+    }
+    void* p0 = m.allocate(1u << 16, 1u << 16);
+    REQUIRE(p0 != nullptr);
+    CHECK(is_aligned(p0, 1u << 16));
+    m.deallocate(p0, 1u << 16, 1u << 16);
+
+    // small requests spill over to the shared heap when all shards are exhausted
+    std::vector<void*> ptrs;
+    while (void* ptr = m.allocate(4096)) ptrs.push_back(ptr);
+    CHECK(ptrs.size() >= 1000);
+    for (auto p : ptrs) m.deallocate(p, 4096);
+    void* p1 = m.allocate(1u << 20);
+    CHECK(p1 != nullptr);
+    m.deallocate(p1, 1u << 20);
+}
+
+TEST_CASE( "adaptive size classes", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    arena_config config;
+    config.adaptive = true;
+    config.sample_period = 1;
+    config.rebuild_period = 100;
+    auto m = resource_builder().alloc_on_host(1u << 22).add_arena(config).build();
+
+    // dominated by two exact sizes, one of them above the slab limit
+    constexpr std::size_t s0 = 2100;
+    constexpr std::size_t s1 = 5000;
+    std::vector<void*> blocks;
+    for (int i = 0; i < 100; ++i) {
+        blocks.push_back(m.allocate(i % 2 ? s0 : s1));
+        REQUIRE(blocks.back() != nullptr);
+    }
+    auto table = m.size_classes();
+    REQUIRE(table.sizes.size() == 2);
+    CHECK(table.sizes[0] == 2112);
+    CHECK(table.sizes[1] == 5008);
+
+    // blocks from exact classes are packed tightly
+    void* p0 = m.allocate(s0);
+    void* p1 = m.allocate(s0);
+    CHECK(static_cast<char*>(p1) - static_cast<char*>(p0) == 2112);
+    m.deallocate(p0, s0);
+    m.deallocate(p1, s0);
+
+    // blocks allocated before and after a rebuild are released correctly
+    for (std::size_t i = 0; i < blocks.size(); ++i) m.deallocate(blocks[i], i % 2 ? s0 : s1);
+
+    // the learned table survives a round trip through a stream and seeds a new arena
+    std::stringstream ss;
+    ss << table;
+    arena_config config2;
+    ss >> config2.size_classes;
+    CHECK(config2.size_classes.sizes == table.sizes);
+    auto m2 = resource_builder().alloc_on_host(1u << 20).add_arena(config2).build();
+    CHECK(m2.size_classes().sizes == table.sizes);
+
+    // replacing the classes retires the slabs which are in use
+    void* q = m2.allocate(s0);
+    m2.rebuild_size_classes();
+    CHECK(m2.size_classes().sizes.empty());
+    void* r = m2.allocate(s0);
+    CHECK(reinterpret_cast<std::uintptr_t>(r) % 4096 == 0);
+    m2.deallocate(q, s0);
+    m2.deallocate(r, s0);
+}
+
+TEST_CASE( "resize in place", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    auto m = resource_builder().alloc_on_host(1u << 20).add_arena().build_any();
+
+    // within the slack of a size class
+    void* p0 = m.allocate(40);
+    CHECK(m.try_resize_in_place(p0, 40, 64));
+    CHECK_FALSE(m.try_resize_in_place(p0, 64, 65));
+    m.deallocate(p0, 64);
+
+    // grow a page block into its free buddies, then shrink it again
+    void* p1 = m.allocate(4096, 1u << 16);
+    REQUIRE(p1 != nullptr);
+    CHECK(m.try_resize_in_place(p1, 4096, 3 * 4096));
+    CHECK(m.try_resize_in_place(p1, 3 * 4096, 1u << 16));
+    void* p2 = m.allocate(4096);
+    CHECK((p2 < p1 || p2 >= static_cast<char*>(p1) + (1u << 16)));
+    CHECK(m.try_resize_in_place(p1, 1u << 16, 4096));
+    // the released pages are available again
+    void* p3 = m.allocate(8192, 8192);
+    CHECK(p3 == static_cast<char*>(p1) + 8192);
+
+    // an allocated buddy prevents growing
+    CHECK_FALSE(m.try_resize_in_place(p1, 4096, 1u << 15));
+    m.deallocate(p3, 8192);
+    m.deallocate(p2, 4096);
+    m.deallocate(p1, 4096);
+
+    // not_arena can grow up to the end of its memory
+    std::vector<char> v(4096);
+    auto n = resource_builder().use_host_memory(v.data(), v.size()).build_any();
+    void* p4 = n.allocate(100);
+    CHECK(n.try_resize_in_place(p4, 100, 4096));
+    CHECK_FALSE(n.try_resize_in_place(p4, 4096, 4097));
+}
+
+TEST_CASE( "allocate at least", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    auto m = resource_builder().alloc_on_host(1u << 20).add_arena().build();
+
+    auto r0 = m.allocate_at_least(100);
+    REQUIRE(r0.ptr != nullptr);
+    CHECK(r0.count == 128);
+    CHECK(m.usable_size(r0.ptr) == 128);
+
+    auto r1 = m.allocate_at_least(5000);
+    CHECK(r1.count == 8192);
+    CHECK(m.usable_size(r1.ptr) == 8192);
+    CHECK(m.try_resize_in_place(r1.ptr, 5000, r1.count));
+
+    m.deallocate(r1.ptr, r1.count);
+    m.deallocate(r0.ptr, r0.count);
+
+    auto s = resource_builder().alloc_on_host(1u << 20).add_sharded_arena(2).build_any();
+    auto r2 = s.allocate_at_least(3000);
+    CHECK(r2.count == 4096);
+    CHECK(s.usable_size(r2.ptr) == 4096);
+    s.deallocate(r2.ptr, r2.count);
+
+    // without an arena on reserved memory, the block spans only what is committed
+    constexpr std::size_t chunk = std::size_t{1} << 21;
+    auto n = resource_builder().reserve_memory(std::size_t{1} << 28).build();
+    auto r3 = n.allocate_at_least(128);
+    REQUIRE(r3.ptr != nullptr);
+    CHECK(n.committed_bytes() == chunk);
+    CHECK(r3.count == chunk);
+    CHECK(n.usable_size(r3.ptr) == chunk);
+    CHECK(n.try_resize_in_place(r3.ptr, r3.count, 3 * chunk));
+    CHECK(n.committed_bytes() == 3 * chunk);
+    CHECK(n.usable_size(r3.ptr) == 3 * chunk);
+}
+
+TEST_CASE( "zeroed allocation", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    auto is_zero = [](void* ptr, std::size_t s) {
+        auto p = static_cast<unsigned char*>(ptr);
+        return std::all_of(p, p + s, [](unsigned char c) { return c == 0; });
+    };
+
+    auto m = resource_builder().alloc_on_host(1u << 22).add_arena().build();
+
+    // recycled pages are cleared, small blocks come from the untouched part of a slab first
+    for (std::size_t s : {48u, 3000u, 40000u, 1u << 21}) {
+        void* p0 = m.allocate_zeroed(s);
+        REQUIRE(p0 != nullptr);
+        CHECK(is_zero(p0, s));
+        std::memset(p0, 0xff, s);
+        m.deallocate(p0, s);
+        void* p1 = m.allocate_zeroed(s);
+        CHECK((s < 4096 || p1 == p0));
+        CHECK(is_zero(p1, s));
+        std::memset(p1, 0xff, s);
+        m.deallocate(p1, s);
+    }
+
+    // decommitted pages are zero again
+    void* p2 = m.allocate(1u << 16);
+    std::memset(p2, 0xff, 1u << 16);
+    m.deallocate(p2, 1u << 16);
+    const auto trimmed = m.trim();
+#if defined(__linux__)
+    CHECK(trimmed >= (1u << 16));
+#endif
+    void* p3 = m.allocate_zeroed(1u << 16);
+    CHECK(is_zero(p3, 1u << 16));
+    m.deallocate(p3, 1u << 16);
+
+    // type erased and user provided memory
+    std::vector<unsigned char> v(4096, 0xff);
+    auto n = resource_builder().use_host_memory(v.data(), v.size()).build_any();
+    CHECK(is_zero(n.allocate_zeroed(100), 100));
+}
+
+TEST_CASE( "trim registered memory", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    auto dirty = [](auto& m) {
+        void* ptr = m.allocate(1u << 16);
+        std::memset(ptr, 0xff, 1u << 16);
+        m.deallocate(ptr, 1u << 16);
+        return static_cast<unsigned char*>(ptr);
+    };
+
+    // registered and pinned pages are not decommitted
+    mock_registry reg;
+    auto m0 = resource_builder().alloc_on_host(1u << 20).register_memory(reg).add_arena().build();
+    auto p0 = dirty(m0);
+    CHECK(m0.trim() == 0);
+    CHECK(p0[0] == 0xff);
+
+    auto m1 = resource_builder().alloc_on_host(1u << 20).pin().add_arena().build();
+    auto p1 = dirty(m1);
+    CHECK(m1.trim() == 0);
+    CHECK(p1[0] == 0xff);
+
+    // unless the registration supports on demand paging
+    mock_registry_config config;
+    config.on_demand_paging = true;
+    mock_registry odp{config};
+    auto m2 = resource_builder().alloc_on_host(1u << 20).register_memory(odp).add_arena().build();
+    dirty(m2);
+#if defined(__linux__)
+    CHECK(m2.trim() >= (1u << 16));
+#endif
+}
+
+TEST_CASE( "tagged allocation", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    auto m = resource_builder().alloc_on_host(1u << 22).add_arena().build();
+    auto page = [](void* ptr) { return reinterpret_cast<std::uintptr_t>(ptr) / 4096u; };
+
+    // interleaved allocations with different tags do not share pages
+    std::vector<void*> persistent, transient;
+    for (int i = 0; i < 1000; ++i) {
+        persistent.push_back(m.allocate(64));
+        transient.push_back(m.allocate(64, alignof(std::max_align_t), 1));
+    }
+    std::vector<std::uintptr_t> pages;
+    for (auto p : persistent) pages.push_back(page(p));
+    std::sort(pages.begin(), pages.end());
+    for (auto p : transient) CHECK(!std::binary_search(pages.begin(), pages.end(), page(p)));
+    for (auto p : transient) m.deallocate(p, 64);
+
+    // sub-arena view, also through type erasure
+    auto v = m.view(1);
+    CHECK(v.tag() == 1);
+    void* p0 = v.allocate(64);
+    CHECK(!std::binary_search(pages.begin(), pages.end(), page(p0)));
+    CHECK(v.usable_size(p0) == 64);
+    v.deallocate(p0, 64);
+
+    any_resource a{m.view(2)};
+    void* p1 = a.allocate(64);
+    CHECK(!std::binary_search(pages.begin(), pages.end(), page(p1)));
+    a.deallocate(p1, 64);
+
+    // unsupported tags are rejected, also on reserved memory which must not grow for them
+    CHECK(m.allocate(64, alignof(std::max_align_t), num_arena_tags) == nullptr);
+    CHECK(m.view(num_arena_tags).allocate(1u << 16) == nullptr);
+    auto r = resource_builder().reserve_memory(std::size_t{1} << 30).add_arena().build();
+    CHECK(r.allocate(64, alignof(std::max_align_t), 255) == nullptr);
+    CHECK(r.committed() == 0);
+
+    for (auto p : persistent) m.deallocate(p, 64);
+}
+
+TEST_CASE( "reserved memory", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    constexpr std::size_t chunk = std::size_t{1} << 21;
+    mock_registry_config config;
+    config.on_demand_paging = true;
+    mock_registry reg{config};
+    auto m = resource_builder().reserve_memory(std::size_t{1} << 30).register_memory(reg).add_arena().build();
+    CHECK(m.committed() == 0);
+    CHECK(m.max_size() >= (std::size_t{1} << 29));
+    CHECK(reg.counters().registrations == 1);
+
+    // memory is committed as the arena grows
+    void* small = m.allocate(100);
+    std::memset(small, 1, 100);
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 8; ++i) {
+        void* ptr = m.allocate(chunk);
+        REQUIRE(ptr != nullptr);
+        std::memset(ptr, 1, chunk);
+        ptrs.push_back(ptr);
+    }
+    const auto committed = m.committed();
+    CHECK(committed >= 8 * chunk);
+    CHECK(committed <= 16 * chunk);
+    const auto k = m.get_key(ptrs.back(), chunk).lkey;
+
+    // and decommitted from the tail
+    for (std::size_t i = 1; i < ptrs.size(); ++i) m.deallocate(ptrs[i], chunk);
+    m.trim();
+    CHECK(m.committed() <= committed - 6 * chunk);
+
+    // committed again on demand, zero initialized and with the same key
+    void* p0 = m.allocate_zeroed(4 * chunk);
+    REQUIRE(p0 != nullptr);
+    CHECK(static_cast<unsigned char*>(p0)[4 * chunk - 1] == 0);
+    CHECK(m.get_key(p0, chunk).lkey == k);
+    m.deallocate(p0, 4 * chunk);
+    m.deallocate(small, 100);
+    m.deallocate(ptrs[0], chunk);
+
+    // requests which never fit commit nothing, others only what their block needs
+    auto r = resource_builder().reserve_memory(std::size_t{1} << 28).add_arena().build();
+    CHECK(r.allocate(std::size_t{1} << 30) == nullptr);
+    CHECK(r.committed_bytes() == 0);
+    if (!r.allocate(std::size_t{1} << 27, std::size_t{1} << 28)) CHECK(r.committed_bytes() == 0);
+    void* p1 = r.allocate(100);
+    REQUIRE(p1 != nullptr);
+    CHECK(r.committed_bytes() <= 2 * chunk);
+    void* p2 = r.allocate(3 * chunk);
+    REQUIRE(p2 != nullptr);
+    CHECK(r.committed_bytes() <= 10 * chunk);
+    r.deallocate(p2, 3 * chunk);
+    r.deallocate(p1, 100);
+}
+
+TEST_CASE( "reserved memory with shards", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    constexpr std::size_t chunk = std::size_t{1} << 21;
+    auto m = resource_builder().reserve_memory(std::size_t{1} << 30).add_sharded_arena(8).build();
+    CHECK(m.committed_bytes() == 0);
+
+    // only the chunks under the blocks are committed, wherever they are in the range
+    void* p0 = m.allocate(64);
+    REQUIRE(p0 != nullptr);
+    std::memset(p0, 1, 64);
+    CHECK(m.committed_bytes() <= chunk);
+    void* p1 = m.allocate(std::size_t{1} << 27);
+    REQUIRE(p1 != nullptr);
+    CHECK(static_cast<std::size_t>(static_cast<unsigned char*>(p1) - static_cast<unsigned char*>(m.data())) >=
+          (std::size_t{1} << 29));
+    static_cast<unsigned char*>(p1)[(std::size_t{1} << 27) - 1] = 1;
+    CHECK(m.committed_bytes() <= (std::size_t{1} << 27) + chunk);
+    // and the page tables grow with the blocks handed out
+    std::size_t num_pages = 0u;
+    for (std::size_t i = 0; i <= m.num_shards(); ++i) num_pages += m._shards[i]._arena.num_pages();
+    CHECK(num_pages * detail::page_size <= 2 * m.committed_bytes());
+    m.deallocate(p1, std::size_t{1} << 27);
+    m.deallocate(p0, 64);
+
+    // registered memory without on demand paging is not decommitted
+    mock_registry reg;
+    auto r = resource_builder().reserve_memory(std::size_t{1} << 30).register_memory(reg).add_arena().build();
+    void* p2 = r.allocate(4 * chunk);
+    r.deallocate(p2, 4 * chunk);
+    const auto committed = r.committed();
+    CHECK(r.trim() == 0);
+    CHECK(r.committed() == committed);
+}
+
+TEST_CASE( "cache line padding and coloring", "[arena]" ) {
+    using namespace hwmalloc2;
+
+    arena_config config;
+    config.cache_line_padding = true;
+    config.num_colors = 8;
+    config.size_classes.sizes = {3000};
+    auto m = resource_builder().alloc_on_host(1u << 24).add_arena(config).build();
+
+    // small blocks do not share cache lines
+    std::vector<std::uintptr_t> lines;
+    for (int i = 0; i < 100; ++i) {
+        void* ptr = m.allocate(16);
+        CHECK(is_aligned(ptr, cache_line_size));
+        lines.push_back(reinterpret_cast<std::uintptr_t>(ptr) / cache_line_size);
+    }
+    std::sort(lines.begin(), lines.end());
+    CHECK(std::adjacent_find(lines.begin(), lines.end()) == lines.end());
+
+    // large blocks start at rotating cache line offsets within the slack of their block
+    constexpr std::size_t large = 250000;
+    std::vector<void*> ptrs;
+    std::vector<std::size_t> offsets;
+    for (int i = 0; i < 8; ++i) {
+        void* ptr = m.allocate(large);
+        REQUIRE(ptr != nullptr);
+        CHECK(is_aligned(ptr, cache_line_size));
+        CHECK(m.usable_size(ptr) >= large);
+        CHECK(m.usable_size(ptr) <= (1u << 18));
+        std::memset(ptr, 1, large);
+        offsets.push_back(reinterpret_cast<std::uintptr_t>(ptr) % 4096u);
+        ptrs.push_back(ptr);
+    }
+    std::sort(offsets.begin(), offsets.end());
+    CHECK(std::unique(offsets.begin(), offsets.end()) - offsets.begin() == 8);
+    CHECK(m.try_resize_in_place(ptrs[1], large, 1u << 17));
+    CHECK(m.usable_size(ptrs[1]) >= (1u << 17));
+    for (auto p : ptrs) m.deallocate(p, 1u << 17);
+
+    // blocks without slack are not colored and take no more memory
+    ptrs.clear();
+    while (void* ptr = m.allocate(1u << 20)) {
+        CHECK(is_aligned(ptr, 4096));
+        CHECK(m.usable_size(ptr) == (1u << 20));
+        ptrs.push_back(ptr);
+    }
+    CHECK(ptrs.size() >= 14);
+    for (auto p : ptrs) m.deallocate(p, 1u << 20);
+
+    // padding does not wrap huge requests around
+    CHECK(m.allocate(SIZE_MAX - 10) == nullptr);
+    CHECK(m.allocate(SIZE_MAX - 10, 4096) == nullptr);
+
+    // page aligned requests are not colored
+    void* p0 = m.allocate(1u << 18, 4096);
+    CHECK(is_aligned(p0, 4096));
+    m.deallocate(p0, 1u << 18, 4096);
+
+    // nor are blocks of the regular classes, slabs of exact-fit classes are
+    offsets.clear();
+    ptrs.clear();
+    for (int i = 0; i < 200; ++i) {
+        void* ptr = m.allocate(3000);
+        std::memset(ptr, 1, 3000);
+        ptrs.push_back(ptr);
+        offsets.push_back(reinterpret_cast<std::uintptr_t>(ptr) % cache_line_size);
+    }
+    CHECK(std::all_of(offsets.begin(), offsets.end(), [](auto o) { return o == 0; }));
+    // the slabs span 64 KiB and the blocks (padded to 3008 bytes) start at the color of their slab
+    std::vector<std::size_t> colors;
+    for (auto p : ptrs) colors.push_back(reinterpret_cast<std::uintptr_t>(p) % 65536u % 3008u / cache_line_size);
+    std::sort(colors.begin(), colors.end());
+    CHECK(std::unique(colors.begin(), colors.end()) - colors.begin() == 8);
+    for (auto p : ptrs) m.deallocate(p, 3000);
+}
@@ -0,0 +1,145 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <hwmalloc2/resource_builder.hpp>
+#include <hwmalloc2/async_resource.hpp>
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+// coroutine which runs eagerly and cleans up after itself
+struct detached {
+    struct promise_type {
+        detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+template<typename R>
+detached send(R& r, std::size_t s, std::vector<void*>& out) {
+    void* ptr = co_await r.allocate_async(s);
+    out.push_back(ptr);
+}
+
+} // namespace
+
+TEST_CASE( "async allocation", "[async]" ) {
+    using namespace hwmalloc2;
+
+    auto m = resource_builder().alloc_on_host(1u << 16).add_arena().build_async();
+
+    // exhaust the memory
+    std::vector<void*> pages;
+    while (void* p = m.allocate(4096)) pages.push_back(p);
+    REQUIRE(pages.size() == 16);
+
+    // requests wait and are served in order
+    std::vector<void*> served;
+    std::vector<int> order;
+    send(m, 4096, served);
+    m.allocate_async(4096, [&](void* p) { order.push_back(1); served.push_back(p); });
+    send(m, 4096, served);
+    CHECK(served.empty());
+    CHECK(m.num_waiters() == 3);
+
+    for (std::size_t i = 1; i <= 3; ++i) {
+        m.deallocate(pages.back(), 4096);
+        pages.pop_back();
+        REQUIRE(served.size() == i);
+        CHECK(served.back() != nullptr);
+        CHECK(m.num_waiters() == 3 - i);
+    }
+    CHECK(order.size() == 1);
+
+    // a small request does not overtake a large one
+    void* large = nullptr;
+    m.allocate_async(1u << 15, [&](void* p) { large = p; });
+    send(m, 4096, served);
+    m.deallocate(served[0], 4096);
+    CHECK(served.size() == 3);
+    CHECK(m.num_waiters() == 2);
+
+    for (auto p : pages) m.deallocate(p, 4096);
+    m.deallocate(served[1], 4096);
+    m.deallocate(served[2], 4096);
+    REQUIRE(large != nullptr);
+    REQUIRE(served.size() == 4);
+    CHECK(m.num_waiters() == 0);
+
+    // served right away
+    m.deallocate(large, 1u << 15);
+    void* p0 = nullptr;
+    m.allocate_async(4096, [&](void* p) { p0 = p; });
+    CHECK(p0 != nullptr);
+    m.deallocate(p0, 4096);
+    m.deallocate(served[3], 4096);
+}
+
+TEST_CASE( "async allocation from threads", "[async]" ) {
+    using namespace hwmalloc2;
+
+    auto m = resource_builder().alloc_on_host(1u << 15).add_arena().build_async();
+
+    // more threads than buffers: senders block on futures instead of spinning
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 100; ++i) {
+                std::promise<void*> p;
+                auto f = p.get_future();
+                m.allocate_async(8192, [&](void* ptr) { p.set_value(ptr); });
+                void* ptr = f.get();
+                if (!ptr) ++failures;
+                else {
+                    static_cast<char*>(ptr)[0] = 1;
+                    std::this_thread::yield();
+                    m.deallocate(ptr, 8192);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    CHECK(failures == 0);
+    CHECK(m.num_waiters() == 0);
+}
+
+TEST_CASE( "async allocation larger than the memory", "[async]" ) {
+    using namespace hwmalloc2;
+
+    auto m = resource_builder().alloc_on_host(1u << 16).add_arena().build_async();
+
+    // requests which can never be served fail right away instead of blocking the queue
+    std::vector<void*> served;
+    send(m, 1u << 20, served);
+    REQUIRE(served.size() == 1);
+    CHECK(served[0] == nullptr);
+    std::promise<void*> p;
+    auto f = p.get_future();
+    m.allocate_async(1u << 20, [&](void* ptr) { p.set_value(ptr); });
+    CHECK(f.get() == nullptr);
+    CHECK(m.num_waiters() == 0);
+
+    send(m, 64, served);
+    m.poll();
+    REQUIRE(served.size() == 2);
+    CHECK(served[1] != nullptr);
+    m.deallocate(served[1], 64);
+}
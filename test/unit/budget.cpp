@@ -0,0 +1,199 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <hwmalloc2/resource_builder.hpp>
+#include <hwmalloc2/budget.hpp>
+#include <hwmalloc2/mock_registry.hpp>
+
+#include <chrono>
+#include <functional>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE( "budget", "[budget]" ) {
+    using namespace hwmalloc2;
+
+    std::size_t watermark_hits = 0u;
+    budget_config config;
+    config.limit = 1u << 16;
+    config.high_watermark = 1u << 15;
+    config.on_high_watermark = [&](std::size_t) { ++watermark_hits; };
+    budget b{config};
+
+    auto m = resource_builder().alloc_on_host(1u << 20).add_arena().build_budgeted(b);
+
+    // blocks are charged with their usable size
+    void* p0 = m.allocate(100);
+    CHECK(b.used() == 128);
+    m.deallocate(p0, 100);
+    CHECK(b.used() == 0);
+
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 8; ++i) ptrs.push_back(m.allocate(8192));
+    CHECK(b.used() == (1u << 16));
+    CHECK(watermark_hits == 1);
+    CHECK(m.allocate(16) == nullptr);
+    CHECK(m.allocate_at_least(16).ptr == nullptr);
+    CHECK(b.counters().failed_charges == 2);
+
+    // resizing stays within the budget
+    CHECK(!m.try_resize_in_place(ptrs[0], 8192, 16384));
+    CHECK(m.try_resize_in_place(ptrs[0], 8192, 4096));
+    CHECK(b.used() == (1u << 16) - 4096);
+    CHECK(m.try_resize_in_place(ptrs[0], 4096, 8192));
+    CHECK(b.used() == (1u << 16));
+
+    for (auto p : ptrs) m.deallocate(p, 8192);
+    CHECK(b.used() == 0);
+    CHECK(b.counters().peak == (1u << 16));
+
+    // the callback fires again after the usage dropped below the watermark
+    void* p1 = m.allocate(1u << 15);
+    CHECK(watermark_hits == 2);
+    m.deallocate(p1, 1u << 15);
+}
+
+TEST_CASE( "budget hard cap", "[budget]" ) {
+    using namespace hwmalloc2;
+
+    budget_config config;
+    config.limit = 1000u << 10;
+    budget b{config};
+    auto m = resource_builder().alloc_on_host(1u << 24).add_arena().build_budgeted(b);
+
+    // the rounding of a block counts against the limit
+    CHECK(m.allocate(520u << 10) == nullptr);
+    CHECK(m.allocate_zeroed(520u << 10) == nullptr);
+    CHECK(b.used() == 0);
+    void* p0 = m.allocate(400u << 10);
+    REQUIRE(p0 != nullptr);
+    CHECK(b.used() == (512u << 10));
+    CHECK(!m.try_resize_in_place(p0, 400u << 10, 600u << 10));
+    CHECK(b.used() == (512u << 10));
+    m.deallocate(p0, 400u << 10);
+
+    // the usage never exceeds the limit
+    std::vector<std::pair<void*, std::size_t>> live;
+    for (std::size_t i = 0; i < 2000; ++i) {
+        const std::size_t s = (i * 7919u) % (300u << 10) + 1;
+        if (i % 3 == 2 && !live.empty()) {
+            m.deallocate(live.back().first, live.back().second);
+            live.pop_back();
+        }
+        else if (void* ptr = (i % 2 ? m.allocate(s) : m.allocate_zeroed(s))) {
+            live.emplace_back(ptr, s);
+            if (i % 5 == 0 && m.try_resize_in_place(ptr, s, 2 * s)) live.back().second = 2 * s;
+        }
+        CHECK(b.used() <= b.limit());
+    }
+    CHECK(b.counters().peak <= b.limit());
+    for (auto [p, s] : live) m.deallocate(p, s);
+    CHECK(b.used() == 0);
+}
+
+TEST_CASE( "locked memory budget", "[budget]" ) {
+    using namespace hwmalloc2;
+
+    budget_config config;
+    config.limit = 3u << 20;
+    budget b{config};
+    mock_registry reg;
+
+    // pinned and registered memory is charged as a whole
+    {
+        auto m0 = resource_builder().alloc_on_host(1u << 21).register_memory(reg, b).add_arena().build();
+        CHECK(b.used() == (1u << 21));
+        auto m1 = resource_builder().alloc_on_host(1u << 20).pin(b).add_arena().build();
+        CHECK(b.used() == (3u << 20));
+        CHECK_THROWS_AS(resource_builder().alloc_on_host(1u << 20).register_memory(reg, b).build(), std::bad_alloc);
+        CHECK(reg.counters().active_registrations == 1);
+    }
+    CHECK(b.used() == 0);
+
+    // reserved memory is charged as it is committed
+    {
+        auto m = resource_builder().reserve_memory(std::size_t{1} << 30).register_memory(reg, b).add_arena().build();
+        CHECK(b.used() == 0);
+        void* p0 = m.allocate(1u << 20);
+        REQUIRE(p0 != nullptr);
+        CHECK(b.used() == m.committed_bytes());
+        CHECK(m.allocate(1u << 22) == nullptr);
+        CHECK(b.used() <= b.limit());
+        CHECK(b.used() == m.committed_bytes());
+        m.deallocate(p0, 1u << 20);
+    }
+    CHECK(b.used() == 0);
+}
+
+TEST_CASE( "budget policies", "[budget]" ) {
+    using namespace hwmalloc2;
+    using namespace std::chrono_literals;
+
+    budget_config config;
+    config.limit = 8192;
+
+    SECTION( "fail" ) {
+        budget b{config};
+        CHECK(b.charge(8192));
+        CHECK(!b.charge(1));
+        b.release(8192);
+    }
+
+    SECTION( "trim" ) {
+        // drop a cached buffer when the budget is exhausted
+        std::function<void()> drop;
+        config.policy = budget_policy::trim;
+        config.reclaim = [&] { if (drop) drop(); };
+        budget b{config};
+        auto r = resource_builder().alloc_on_host(1u << 20).add_arena().build_budgeted(b);
+
+        void* cached = r.allocate(8192);
+        drop = [&] { if (cached) r.deallocate(std::exchange(cached, nullptr), 8192); };
+        void* p = r.allocate(4096);
+        CHECK(p != nullptr);
+        CHECK(cached == nullptr);
+        CHECK(b.used() == 4096);
+        r.deallocate(p, 4096);
+    }
+
+    SECTION( "wait" ) {
+        config.policy = budget_policy::wait;
+        config.timeout = 10ms;
+        budget b0{config};
+        CHECK(b0.charge(8192));
+        CHECK(!b0.charge(4096));
+        // requests larger than the limit fail right away
+        CHECK(!b0.charge(16384));
+        b0.release(8192);
+
+        // a release by another thread unblocks the allocation
+        config.timeout = std::chrono::nanoseconds::max();
+        budget b{config};
+        auto r = resource_builder().alloc_on_host(1u << 20).add_arena().build_budgeted(b);
+        void* p0 = r.allocate(8192);
+        REQUIRE(p0 != nullptr);
+        std::thread t{[&] {
+            std::this_thread::sleep_for(1ms);
+            r.deallocate(p0, 8192);
+        }};
+        void* p1 = r.allocate(4096);
+        t.join();
+        CHECK(p1 != nullptr);
+        r.deallocate(p1, 4096);
+        CHECK(b.used() == 0);
+    }
+
+    SECTION( "process" ) {
+        CHECK(budget::process().limit() == detail::memlock_limit());
+    }
+}
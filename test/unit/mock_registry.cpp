@@ -0,0 +1,63 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <hwmalloc2/resource_builder.hpp>
+#include <hwmalloc2/mock_registry.hpp>
+
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE( "mock registry", "[registry]" ) {
+    using namespace hwmalloc2;
+    using namespace std::chrono_literals;
+
+    mock_registry_config config;
+    config.registration_latency = 200us;
+    config.per_page_cost = 1us;
+    config.max_registrations = 2;
+    mock_registry reg{config};
+
+    {
+        const auto start = std::chrono::steady_clock::now();
+        auto m0 = resource_builder().alloc_on_host(1u << 20).register_memory(reg).add_arena().build();
+        CHECK(std::chrono::steady_clock::now() - start >= 200us + 256us);
+
+        auto m1 = std::move(m0);
+        void* ptr = m1.allocate(128);
+        auto k = m1.get_key(ptr, 128);
+        m1.deallocate(ptr, 128);
+
+        auto m2 = resource_builder().alloc_on_host(4096).register_memory(reg).build();
+        CHECK(m2.get_key(m2.allocate(16), 16).lkey != k.lkey);
+
+        // all slots are taken
+        CHECK_THROWS_AS(resource_builder().alloc_on_host(4096).register_memory(reg).build(), std::runtime_error);
+
+        auto c = reg.counters();
+        CHECK(c.registrations == 2);
+        CHECK(c.failed_registrations == 1);
+        CHECK(c.active_registrations == 2);
+        CHECK(c.pinned_bytes == (1u << 20) + 4096);
+        CHECK(c.lookups == 2);
+    }
+
+    // moved-from resources do not deregister
+    auto c = reg.counters();
+    CHECK(c.deregistrations == 2);
+    CHECK(c.active_registrations == 0);
+    CHECK(c.pinned_bytes == 0);
+    CHECK(c.peak_pinned_bytes == (1u << 20) + 4096);
+
+    reg.reset_counters();
+    CHECK(reg.counters().registrations == 0);
+    CHECK(reg.counters().peak_pinned_bytes == 0);
+}
@@ -0,0 +1,73 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <hwmalloc2/resource_builder.hpp>
+#include <hwmalloc2/object_pool.hpp>
+
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+struct descriptor {
+    static inline int alive = 0;
+    int tag;
+    std::size_t bytes;
+    descriptor(int t, std::size_t b) : tag{t}, bytes{b} {
+        if (t < 0) throw std::runtime_error("bad tag");
+        ++alive;
+    }
+    ~descriptor() { --alive; }
+};
+
+} // namespace
+
+TEST_CASE( "object pool", "[object_pool]" ) {
+    using namespace hwmalloc2;
+
+    auto m = resource_builder().alloc_on_host(1u << 20).add_arena().build();
+    object_pool<descriptor, decltype(m)> pool{m, 16};
+
+    static_assert(decltype(pool)::slot_size % cache_line_size == 0);
+
+    auto h = pool.construct(1, 128u);
+    CHECK(h.ptr->tag == 1);
+    CHECK(reinterpret_cast<std::uintptr_t>(h.ptr) % cache_line_size == 0);
+    // keys are those of the underlying resource
+    CHECK(h.key.ptr == h.ptr);
+    CHECK(pool.get_key(h.ptr).ptr == h.ptr);
+    CHECK(descriptor::alive == 1);
+
+    pool.destroy(h);
+    CHECK(descriptor::alive == 0);
+
+    // slots are recycled
+    auto h2 = pool.construct(2, 64u);
+    CHECK(h2.ptr == h.ptr);
+    pool.destroy(h2);
+
+    // a throwing constructor returns the slot
+    const auto n_free = pool.num_free();
+    CHECK_THROWS_AS(pool.construct(-1, 0u), std::runtime_error);
+    CHECK(pool.num_free() == n_free);
+
+    // bulk construction spanning several chunks
+    std::vector<decltype(pool)::handle> handles;
+    pool.construct_n(40, std::back_inserter(handles), 3, 32u);
+    CHECK(handles.size() == 40);
+    CHECK(descriptor::alive == 40);
+    for (auto& x : handles) CHECK(x.key.ptr == x.ptr);
+    pool.destroy_n(handles.begin(), handles.size());
+    CHECK(descriptor::alive == 0);
+    CHECK(pool.num_free() == 48);
+}
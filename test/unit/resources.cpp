@@ -18,6 +18,7 @@
 #include <hwmalloc2/resource/arena.hpp>
 #include <hwmalloc2/resource/not_arena.hpp>
 #include <hwmalloc2/any_resource.hpp>
+#include <hwmalloc2/variant_resource.hpp>
 
 #include <hwmalloc2/resource_builder.hpp>
 
@@ -290,3 +291,35 @@ TEST_CASE( "host memory2", "[concat]" ) {
         m.deallocate(my_ptr, 128);
     }
 }
+
+TEST_CASE( "variant resource", "[type_erasure]" ) {
+    using namespace hwmalloc2;
+
+    static constexpr auto b0 = resource_builder().add_arena();
+    using host_arena_t = decltype(b0.alloc_on_host(0).build());
+    using user_t = decltype(resource_builder().use_host_memory(nullptr, 0).build());
+    using resource_t = variant_resource<host_arena_t, user_t>;
+
+    std::vector<char> v(4096);
+    std::vector<resource_t> resources;
+    resources.emplace_back(b0.alloc_on_host(1u << 16));
+    resources.emplace_back(resource_builder().use_host_memory(v.data(), v.size()));
+
+    CHECK(resources[0].index() == 0);
+    CHECK(resources[1].index() == 1);
+
+    for (auto& m : resources) {
+        auto r = m.allocate_at_least(128);
+        REQUIRE(r.ptr != nullptr);
+        CHECK(r.count >= 128);
+        CHECK(m.usable_size(r.ptr) == r.count);
+        auto k = m.get_key(r.ptr, 128);
+        CHECK(k.has_value());
+        m.deallocate(r.ptr, 128);
+    }
+
+    // typed access to the concrete resource
+    void* ptr = resources[1].allocate(16);
+    auto key_ptr = resources[1].visit([ptr](auto& r) { return r.get_key(ptr, 16).ptr; });
+    CHECK(key_ptr == ptr);
+}
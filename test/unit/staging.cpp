@@ -0,0 +1,74 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2023, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <hwmalloc2/resource_builder.hpp>
+#include <hwmalloc2/staging.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE( "copy engine", "[staging]" ) {
+    using namespace hwmalloc2;
+
+    for (auto isa : {copy_isa::scalar, copy_isa::avx2, copy_isa::avx512}) {
+        // a zero threshold forces non-temporal stores
+        for (std::size_t threshold : {std::size_t{0}, copy_engine::default_nt_threshold}) {
+            const copy_engine e{isa, threshold};
+
+            std::vector<unsigned char> src(100000);
+            std::iota(src.begin(), src.end(), 0);
+
+            // contiguous, with unaligned destination
+            std::vector<unsigned char> dst(src.size() + 1);
+            e.copy(dst.data() + 1, src.data(), src.size());
+            CHECK(std::equal(src.begin(), src.end(), dst.begin() + 1));
+
+            for (std::size_t block : {std::size_t{8}, std::size_t{24}, std::size_t{1000}}) {
+                const strided_layout l{src.size() / (block + 40), block, block + 40};
+                std::vector<unsigned char> packed(l.packed_size());
+                e.pack(packed.data(), src.data(), l);
+                bool ok = true;
+                for (std::size_t i = 0; i < l.count; ++i)
+                    ok = ok && std::equal(packed.begin() + i * block, packed.begin() + (i + 1) * block, src.begin() + i * l.stride);
+                CHECK(ok);
+
+                std::vector<unsigned char> unpacked(src.size(), 0);
+                e.unpack(unpacked.data(), packed.data(), l);
+                for (std::size_t i = 0; i < l.count; ++i)
+                    ok = ok && std::equal(unpacked.begin() + i * l.stride, unpacked.begin() + i * l.stride + block, src.begin() + i * l.stride);
+                CHECK(ok);
+            }
+        }
+    }
+}
+
+TEST_CASE( "stage into resource", "[staging]" ) {
+    using namespace hwmalloc2;
+
+    auto m = resource_builder().alloc_on_host(1u << 20).add_arena().build();
+
+    std::vector<double> field(64 * 64);
+    std::iota(field.begin(), field.end(), 0.0);
+    // one column of a 64x64 grid
+    const strided_layout l{64, sizeof(double), 64 * sizeof(double)};
+
+    auto b = stage(m, field.data(), l);
+    REQUIRE(b);
+    CHECK(b->size == 64 * sizeof(double));
+    CHECK(b->key.ptr == b->ptr);
+    CHECK(static_cast<double*>(b->ptr)[3] == 3 * 64.0);
+
+    std::vector<double> out(64 * 64, -1.0);
+    unstage(m, *b, out.data(), l);
+    CHECK(out[64 * 5] == field[64 * 5]);
+    CHECK(out[1] == -1.0);
+}